@@ -0,0 +1,427 @@
+// Time DRYopt against getopt_long(3), and argp where there is one (glibc).
+// Run through `make bench', which builds dryopt.c optimised for the purpose
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime(2) */
+
+#include "../dryopt.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#  include <argp.h>
+#  define HAVE_ARGP 1
+#endif
+
+typedef void bench_fn(int argc, char *argv[]);
+
+/* The table from tests/test-bin.c, less the printing */
+
+static short value;
+static uintmax_t bigvalue;
+static char * strarg;
+static bool flag;
+static double fl;
+static enum { NEVER, AUTO, ALWAYS } e;
+static char const *const enum_args[] = { "never", "auto", "always", NULL };
+static unsigned long called;
+
+static size_t callback(struct dryopt const * opt __attribute__((unused)), char const * arg) {
+	called++;
+	return arg ? strlen(arg) : 0;
+}
+
+static struct dryopt opts[] = {
+	DRYOPT(L'v', "value",	"set value", REQ_ARG, &value, 0),
+	DRYOPT(L'b', "bigvalue",	"set bigvalue", OPT_ARG, &bigvalue, 0),
+	DRYOPT(L's', "strarg",	"set strarg", OPT_ARG, &strarg, 0),
+	DRYOPT(L'n', "flag",	"boolean; takes no argument", NO_ARG, &flag, 1),
+	DRYOPT(L'F', "float",	"set fl (double)", REQ_ARG, &fl, 0),
+	{ L'e', "enum", "pick one of a predetermined set of arguments",
+		ENUM_ARG, 0, 0, sizeof e, .argptr = &e, .enum_args = enum_args },
+	{ L'c', "callback", "call callback", CALLBACK, OPT_ARG, .callback = callback }
+};
+#define OPTN (sizeof opts / sizeof *opts)
+
+static struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+static char compiled[4096];
+
+static void
+run_dryopt(int argc __attribute__((unused)), char *argv[])
+{
+	dryopt_parse_r(&ctx, argv, opts, OPTN);
+}
+
+static void
+run_compiled(int argc __attribute__((unused)), char *argv[])
+{
+	dryopt_parse_compiled(&ctx, argv, compiled);
+}
+
+/* The getopt_long(3) (and argp) equivalent: the usual hand-rolled
+   conversions, checked as far as DRYopt checks them */
+
+static struct option const longopts[] = {
+	{ "value", required_argument, NULL, 'v' },
+	{ "bigvalue", optional_argument, NULL, 'b' },
+	{ "strarg", optional_argument, NULL, 's' },
+	{ "flag", no_argument, NULL, 'n' },
+	{ "no-flag", no_argument, NULL, 'N' },
+	{ "float", required_argument, NULL, 'F' },
+	{ "enum", required_argument, NULL, 'e' },
+	{ "callback", optional_argument, NULL, 'c' },
+	{ NULL, 0, NULL, 0 }
+};
+
+static int
+apply(int const c, char *const arg)
+// 0 if it was one of ours
+{
+	char * end;
+	long l;
+	size_t i;
+
+	errno = 0;
+	switch (c) {
+	case 'v':
+		l = strtol(arg, &end, 0);
+		if (errno || *end || l < SHRT_MIN || l > SHRT_MAX)
+			return 1;
+		value = l;
+		break;
+	case 'b':
+		if (!arg)
+			bigvalue = 0;
+		else if (bigvalue = strtoumax(arg, &end, 0), errno || *end)
+			return 1;
+		break;
+	case 's':
+		strarg = arg;
+		break;
+	case 'n':
+	case 'N':
+		flag = c == 'n';
+		break;
+	case 'F':
+		if (fl = strtod(arg, &end), errno || *end)
+			return 1;
+		break;
+	case 'e':
+		for (i = 0; enum_args[i] && strcmp(arg, enum_args[i]); i++);
+		if (!enum_args[i])
+			return 1;
+		e = i;
+		break;
+	case 'c':
+		callback(NULL, arg);
+		break;
+	default:
+		return 1;
+	}
+	return 0;
+}
+
+static void
+getopt_reset(void)
+{
+	/* 0 has glibc and musl reinitialise entirely; the BSDs want optreset */
+#if defined __GLIBC__ || !(defined __FreeBSD__ || defined __NetBSD__ || defined __OpenBSD__ || defined __APPLE__)
+	optind = 0;
+#else
+	optind = optreset = 1;
+#endif
+}
+
+static void
+run_getopt(int argc, char *argv[])
+{
+	int c;
+	getopt_reset();
+	while ((c = getopt_long(argc, argv, "+v:b::s::nF:e:c::", longopts, NULL)) != -1)
+		if (apply(c, optarg))
+			abort();
+}
+
+#ifdef HAVE_ARGP
+static struct argp_option const argp_opts[] = {
+	{ "value", 'v', "SIGNED", 0, "set value", 0 },
+	{ "bigvalue", 'b', "UNSIGNED", OPTION_ARG_OPTIONAL, "set bigvalue", 0 },
+	{ "strarg", 's', "STR", OPTION_ARG_OPTIONAL, "set strarg", 0 },
+	{ "flag", 'n', NULL, 0, "boolean; takes no argument", 0 },
+	{ "no-flag", 'N', NULL, 0, NULL, 0 },
+	{ "float", 'F', "FLOATING", 0, "set fl (double)", 0 },
+	{ "enum", 'e', "never,auto,always", 0, "pick one of a predetermined set of arguments", 0 },
+	{ "callback", 'c', "ARG", OPTION_ARG_OPTIONAL, "call callback", 0 },
+	{ 0 }
+};
+
+static error_t
+argp_parser(int key, char *arg, struct argp_state *state __attribute__((unused)))
+{
+	if (key == ARGP_KEY_ARG || key > 0xff)
+		return ARGP_ERR_UNKNOWN;
+	return apply(key, arg) ? EINVAL : 0;
+}
+
+static struct argp const argp = { argp_opts, argp_parser, NULL, NULL, NULL, NULL, NULL };
+
+static void
+run_argp(int argc, char *argv[])
+{
+	if (argp_parse(&argp, argc, argv, ARGP_NO_EXIT | ARGP_NO_HELP | ARGP_IN_ORDER, NULL, NULL))
+		abort();
+}
+#endif
+
+/* Synthetic tables of n UNSIGNED options, --o00000 to --oNNNNN, so that
+   they're already sorted */
+
+#define SYNTH_MAX 10000
+#define SYNTH_ARGS 64
+
+static unsigned synth_vals[SYNTH_MAX];
+static char synth_names[SYNTH_MAX][sizeof "o00000"];
+static struct dryopt synth_opts[SYNTH_MAX];
+static struct option synth_longopts[SYNTH_MAX + 1];
+#ifdef HAVE_ARGP
+static struct argp_option synth_argp_opts[SYNTH_MAX + 1];
+#endif
+static size_t synth_n;
+static struct dryopt_ctx synth_ctx = { .config = { .sorting = already_sorted, .wrap = 80 } };
+static void * synth_compiled;
+
+static void
+synth_setup(size_t const n)
+{
+	size_t i, size;
+
+	synth_n = n;
+	for (i = 0; i < n; i++) {
+		sprintf(synth_names[i], "o%05u", (unsigned)i);
+		synth_opts[i] = (struct dryopt)DRYOPT(0, synth_names[i], NULL, REQ_ARG, &synth_vals[i], 0);
+		synth_longopts[i] = (struct option){ synth_names[i], required_argument, NULL, 0x100 + i };
+#ifdef HAVE_ARGP
+		synth_argp_opts[i] = (struct argp_option){ synth_names[i], 0x100 + i, "N", 0, NULL, 0 };
+#endif
+	}
+	synth_longopts[n] = (struct option){ 0 };
+#ifdef HAVE_ARGP
+	synth_argp_opts[n] = (struct argp_option){ 0 };
+#endif
+
+	free(synth_compiled);
+	size = dryopt_compile(&synth_ctx, synth_opts, n, NULL, 0);
+	if (!size || !(synth_compiled = malloc(size)))
+		abort();
+	dryopt_compile(&synth_ctx, synth_opts, n, synth_compiled, size);
+}
+
+static void
+run_synth_dryopt(int argc __attribute__((unused)), char *argv[])
+{
+	dryopt_parse_r(&synth_ctx, argv, synth_opts, synth_n);
+}
+
+static void
+run_synth_compiled(int argc __attribute__((unused)), char *argv[])
+{
+	dryopt_parse_compiled(&synth_ctx, argv, synth_compiled);
+}
+
+static void
+run_synth_getopt(int argc, char *argv[])
+{
+	int c;
+	char * end;
+
+	getopt_reset();
+	while ((c = getopt_long(argc, argv, "+", synth_longopts, NULL)) != -1) {
+		unsigned long const ul = (errno = 0, strtoul(optarg, &end, 0));
+		if (c < 0x100 || errno || *end || ul > UINT_MAX)
+			abort();
+		synth_vals[c - 0x100] = ul;
+	}
+}
+
+#ifdef HAVE_ARGP
+static error_t
+synth_argp_parser(int key, char *arg, struct argp_state *state __attribute__((unused)))
+{
+	char * end;
+	unsigned long ul;
+
+	if (key < 0x100 || key >= 0x100 + (int)synth_n)
+		return ARGP_ERR_UNKNOWN;
+	errno = 0;
+	ul = strtoul(arg, &end, 0);
+	if (errno || *end || ul > UINT_MAX)
+		return EINVAL;
+	synth_vals[key - 0x100] = ul;
+	return 0;
+}
+
+static struct argp const synth_argp = { synth_argp_opts, synth_argp_parser, NULL, NULL, NULL, NULL, NULL };
+
+static void
+run_synth_argp(int argc, char *argv[])
+{
+	if (argp_parse(&synth_argp, argc, argv, ARGP_NO_EXIT | ARGP_NO_HELP | ARGP_IN_ORDER, NULL, NULL))
+		abort();
+}
+#endif
+
+/* The harness */
+
+static struct parser {
+	char const * name;
+	bench_fn * fn, * synth;
+} const parsers[] = {
+	{ "dryopt_parse_r", run_dryopt, run_synth_dryopt },
+	{ "dryopt_parse_compiled", run_compiled, run_synth_compiled },
+	{ "getopt_long", run_getopt, run_synth_getopt },
+#ifdef HAVE_ARGP
+	{ "argp_parse", run_argp, run_synth_argp },
+#endif
+};
+
+static double min_time = 0.2;
+static char * filter;
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench(char const *const name, char const *const parser, bench_fn *const fn, char *argv[])
+{
+	int argc;
+	unsigned long n, i;
+	double t;
+
+	if (filter && !strstr(name, filter) && !strstr(parser, filter))
+		return;
+	for (argc = 0; argv[argc]; argc++);
+
+	/* double the iterations until it takes long enough to measure */
+	for (n = 1;; n *= 2) {
+		double const start = now();
+		for (i = 0; i < n; i++)
+			fn(argc, argv);
+		t = now() - start;
+		if (t >= min_time || n > ULONG_MAX / 2)
+			break;
+		if (t > 0 && t < min_time / 4)
+			n *= 2;
+	}
+	t = t * 1e9 / n;
+	printf("%-16s %-22s %9.1f %12.1f\n", name, parser, t / (argc - 1), t);
+	fflush(stdout);
+}
+
+static void
+bench_all(char const *const name, char *argv[], bool const synth)
+{
+	size_t i;
+	for (i = 0; i < sizeof parsers / sizeof *parsers; i++)
+		bench(name, parsers[i].name, synth ? parsers[i].synth : parsers[i].fn, argv);
+}
+
+/* argv strings must be writable, as DRYopt and getopt_long(3) may split
+   them (if only for a moment) */
+#define W(S) (char[]){ S }
+
+/* A large argv, cycling through these */
+#define BIG_ARGC 1000000
+static char *const big_args[] = {
+	W("--value=5"), W("-n"), W("--no-flag"), W("-F1.5"), W("--enum=auto"), W("-sx"),
+	W("-nv-7"), W("--callback=c")
+};
+
+int
+main(int argc __attribute__((unused)), char *argv[])
+{
+	char * bundles[] = { W("bench"), W("-nv32767"), W("-nF2.5"), W("-neauto"), W("-nsstr"),
+		W("-v"), W("-12"), NULL };
+	char * longs[] = { W("bench"), W("--value=12"), W("--float=2.5"), W("--strarg=x"),
+		W("--bigvalue=99"), W("--enum=never"), NULL };
+	char * negations[] = { W("bench"), W("--no-flag"), W("--flag"), W("--no-flag"), W("--flag"),
+		W("--no-flag"), NULL };
+	char * numbers[] = { W("bench"), W("--value=-300"), W("-v0x7fff"),
+		W("--bigvalue=18446744073709551615"), W("--float=1e-3"), W("-F6.02214076e23"), NULL };
+	char * enums[] = { W("bench"), W("--enum=never"), W("--enum"), W("always"), W("-eauto"), NULL };
+	char * callbacks[] = { W("bench"), W("--callback=yeeble"), W("-cdeeble"), W("-c"),
+		W("--callback"), NULL };
+	char * synth_argv[SYNTH_ARGS + 2], synth_args[SYNTH_ARGS][sizeof "--o00000=4294967295"];
+	// --strarg=xxx... of 4KiB, like a --filter=<expression>
+	static char huge_args[4][4096];
+	char * huge[] = { W("bench"), huge_args[0], huge_args[1], huge_args[2], huge_args[3], NULL };
+	static char * big[BIG_ARGC + 2];
+	size_t const sizes[] = { 10, 100, 1000, SYNTH_MAX };
+	char name[sizeof "synthetic-10000"];
+	size_t i, j;
+
+	struct dryopt bench_opts[] = {
+		DRYOPT(L't', "time", "minimum seconds to spend on each benchmark (default: 0.2)",
+			REQ_ARG, &min_time, 0),
+		DRYOPT(L'f', "filter", "only run the benchmarks whose case or parser includes STR",
+			REQ_ARG, &filter, 0)
+	};
+	DRYopt_help_args = "", DRYopt_help_extra =
+		"Time DRYopt against getopt_long(3), and argp(3) where there is one. Prints\n"
+		"nanoseconds per argument and per invocation (parse of the whole argv).\n";
+	argv += DRYOPT_PARSE(argv, bench_opts);
+	if (*argv) {
+		fprintf(stderr, "%s: %s: unexpected operand\n", prognam, *argv);
+		return 1;
+	}
+
+	opterr = 0;
+	if (!dryopt_compile(&ctx, opts, OPTN, compiled, sizeof compiled))
+		return 2;
+
+	printf("%-16s %-22s %9s %12s\n", "case", "parser", "ns/arg", "ns/call");
+	bench_all("short-bundles", bundles, false);
+	bench_all("long-equals", longs, false);
+	bench_all("negations", negations, false);
+	bench_all("numeric", numbers, false);
+	bench_all("enum", enums, false);
+	bench_all("callback", callbacks, false);
+	for (i = 0; i < sizeof huge_args / sizeof *huge_args; i++) {
+		memset(huge_args[i], 'x', sizeof huge_args[i] - 1);
+		memcpy(huge_args[i], "--strarg=", strlen("--strarg="));
+	}
+	bench_all("4KiB-strings", huge, false);
+
+	srand(1);
+	for (i = 0; i < sizeof sizes / sizeof *sizes; i++) {
+		synth_setup(sizes[i]);
+		synth_argv[0] = "bench";
+		for (j = 0; j < SYNTH_ARGS; j++) {
+			sprintf(synth_args[j], "--o%05zu=%d", (size_t)rand() % sizes[i], rand());
+			synth_argv[j + 1] = synth_args[j];
+		}
+		synth_argv[j + 1] = NULL;
+		sprintf(name, "synthetic-%zu", sizes[i]);
+		bench_all(name, synth_argv, true);
+	}
+
+	big[0] = "bench";
+	for (i = 0; i < BIG_ARGC; i++)
+		big[i + 1] = big_args[i % (sizeof big_args / sizeof *big_args)];
+	big[i + 1] = NULL;
+	bench_all("argv-1M", big, false);
+
+	free(synth_compiled);
+	return 0;
+}
@@ -0,0 +1,683 @@
+/* SPDX-FileCopyrightText:  2024 The Remph <lhr@disroot.org>
+   SPDX-License-Identifier: LGPL-3.0-or-later WITH LGPL-3.0-linking-exception */
+
+/*
+dryopt-gen: turn an option spec into C source for a struct dryopt[] plus a
+minimal perfect hash over its long options (struct dryopt_phash), so that
+dryopt_parse_phash() finds each long option with one hash and one memcmp(3).
+
+The spec is line-based. Blank lines and lines starting with `#' are
+ignored. Everything between a line `%{' and a line `%}' is copied verbatim
+before the table (so #include "dryopt.h" goes there), and everything after
+a line `%%' is copied verbatim after it. `%name IDENT' names the table
+(default: opts). Any other line is an option, with tab-separated fields:
+
+	SHORT	LONG	TAKES_ARG	TARGET	VALUE	HELP
+
+SHORT is a single (UTF-8) character, LONG the long option name, and HELP
+the rest of the line; any of those can be `-' for none. TAKES_ARG is one of
+NO_ARG, OPT_ARG, REQ_ARG, ENUM_ARG or RANGES, optionally followed by /AND,
+/OR or /XOR for .set_arg. TARGET is passed to DRYARG() (or, for ENUM_ARG,
+is a pointer to the enum, and for RANGES, an array of uint64_t) and VALUE
+is .assign_val, or for ENUM_ARG the NULL-terminated string vector; `-'
+means 0. The output uses DRYARG(), so needs C11.
+
+Also emitted is NAME_phash, and a macro NAME_PARSE(ARGV) to parse with it.
+
+Help can be generated at build time too. With `%help FILE', the output
+compiled with -DDRYOPT_GEN_HELP is instead a program that, run as
+`PROG FILE [MANPAGE]', writes NAME_help_text (see dryopt_help_c()) to FILE
+and a man page to MANPAGE. Otherwise the output #includes FILE, and
+NAME_phash points at it, so NAME_PARSE() prints that for --help. These go
+into the help:
+
+	%prog NAME	program name for the help and man page, in place of
+			argv[0] (default: SPEC's basename, less any
+			extension)
+	%args EXPR	DRYopt_help_args, as a C expression
+	%extra EXPR	DRYopt_help_extra, likewise
+	%section N	man page section (default: 1)
+*/
+
+#include "dryopt.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct entry {
+	char const *shortopt, *longopt, *takes_arg, *set_arg, *target, *value, *helpstr;
+	unsigned long line;
+};
+
+struct key {
+	char * s;
+	size_t len, opti;
+	uint32_t h;
+	bool negated;
+};
+
+static char const * infile = "-";
+static char * outfile = NULL;
+
+static void __attribute__((noreturn, format(__printf__, 2, 3)))
+fatal(unsigned long const line, char const *const fmt, ...)
+{
+	va_list va;
+	if (line)
+		fprintf(stderr, "%s:%s:%lu: ", prognam, infile, line);
+	else
+		fprintf(stderr, "%s: ", prognam);
+	va_start(va, fmt);
+	vfprintf(stderr, fmt, va);
+	va_end(va);
+	putc('\n', stderr);
+	exit(EXIT_FAILURE);
+}
+
+static void *
+xrealloc(void *const p, size_t const n)
+{
+	void *const ret = realloc(p, n);
+	if (!ret)
+		fatal(0, "%s", strerror(errno));
+	return ret;
+}
+
+static char *
+slurp(FILE *const in)
+{
+	size_t len = 0, cap = 0;
+	char * buf = NULL;
+
+	do {
+		if (cap - len < BUFSIZ)
+			buf = xrealloc(buf, cap = cap * 2 + BUFSIZ);
+		len += fread(buf + len, 1, cap - len - 1, in);
+	} while (!feof(in) && !ferror(in));
+
+	if (ferror(in))
+		fatal(0, "%s: %s", infile, strerror(errno));
+	buf[len] = '\0';
+	return buf;
+}
+
+static char *
+directive(char *const line, char const *const name, unsigned long const lineno)
+// the argument if line is `%name ARG', else NULL
+{
+	size_t const len = strlen(name);
+	char * arg;
+
+	if (*line != '%' || strncmp(line + 1, name, len) || (line[len + 1] && !strchr(" \t", line[len + 1])))
+		return NULL;
+	arg = line + 1 + len;
+	arg += strspn(arg, " \t");
+	if (!*arg)
+		fatal(lineno, "%%%s needs an argument", name);
+	return arg;
+}
+
+static char *
+default_prog(char const *const path)
+// basename(3), less the extension
+{
+	char const *const slash = strrchr(path, '/');
+	char const *const base = slash ? slash + 1 : path;
+	size_t const len = strcspn(base, ".");
+	char *const ret = xrealloc(NULL, len + 1);
+	memcpy(ret, base, len), ret[len] = '\0';
+	return ret;
+}
+
+static char const *
+none_if_dash(char const *const s)
+{
+	return strcmp(s, "-") == 0 ? NULL : s;
+}
+
+static long
+utf8_char(char const *const s, unsigned long const line)
+// Returns the code point of the single character s
+{
+	unsigned char const *u = (unsigned char const*)s;
+	long c;
+	int n;
+
+	if (*u < 0x80)		c = *u, n = 0;
+	else if (*u >> 5 == 6)	c = *u & 0x1f, n = 1;
+	else if (*u >> 4 == 14)	c = *u & 0x0f, n = 2;
+	else if (*u >> 3 == 30)	c = *u & 0x07, n = 3;
+	else			goto bad;
+
+	while (n--)
+		if ((*++u & 0xc0) == 0x80)
+			c = c << 6 | (*u & 0x3f);
+		else
+			goto bad;
+
+	if (!*++u)
+		return c;
+bad:
+	fatal(line, "bad short option `%s': must be one UTF-8 character", s);
+}
+
+static void
+put_string(FILE *const out, char const * s)
+{
+	if (!s) {
+		fputs("NULL", out);
+		return;
+	}
+
+	putc('"', out);
+	for (; *s; s++)
+		switch (*s) {
+		case '"': case '\\':
+			fprintf(out, "\\%c", *s);
+			break;
+		case '\n':
+			fputs("\\n", out);
+			break;
+		case '\t':
+			fputs("\\t", out);
+			break;
+		default:
+			/* octal escapes are at most three digits, unlike hex
+			   ones, so can't swallow what follows */
+			if ((unsigned char)*s < ' ' || *s == 0x7f)
+				fprintf(out, "\\%03o", (unsigned char)*s);
+			else
+				putc(*s, out);
+		}
+	putc('"', out);
+}
+
+static void
+put_shortopt(FILE *const out, struct entry const *const e)
+{
+	long c;
+
+	if (!e->shortopt) {
+		putc('0', out);
+		return;
+	}
+
+	c = utf8_char(e->shortopt, e->line);
+	if (c >= ' ' && c < 0x7f && c != '\'' && c != '\\')
+		fprintf(out, "L'%c'", (int)c);
+	else
+		fprintf(out, "(wchar_t)0x%lx", c);
+}
+
+static void
+parse_entry(char * line, unsigned long const lineno, struct entry *const e)
+{
+	char * fields[6], * set_arg;
+	size_t i;
+
+	for (i = 0; i < 5; i++) {
+		fields[i] = line;
+		if (!(line = strchr(line, '\t')))
+			fatal(lineno, "expected 6 tab-separated fields, got %zu", i + 1);
+		*line++ = '\0';
+		line += strspn(line, "\t");
+	}
+	fields[5] = line;
+
+	e->line = lineno;
+	e->shortopt = none_if_dash(fields[0]);
+	e->longopt = none_if_dash(fields[1]);
+	e->takes_arg = fields[2];
+	e->target = fields[3];
+	e->value = none_if_dash(fields[4]);
+	e->helpstr = none_if_dash(fields[5]);
+
+	if ((set_arg = strchr(fields[2], '/')))
+		*set_arg++ = '\0';
+	if ((e->set_arg = set_arg)
+	    && strcmp(set_arg, "AND") && strcmp(set_arg, "OR") && strcmp(set_arg, "XOR"))
+		fatal(lineno, "bad set_arg `%s'", set_arg);
+
+	if (strcmp(e->takes_arg, "NO_ARG") && strcmp(e->takes_arg, "OPT_ARG")
+	    && strcmp(e->takes_arg, "REQ_ARG") && strcmp(e->takes_arg, "ENUM_ARG")
+	    && strcmp(e->takes_arg, "RANGES"))
+		fatal(lineno, "bad TAKES_ARG `%s'", e->takes_arg);
+
+	if (strcmp(e->takes_arg, "ENUM_ARG") == 0 && !e->value)
+		fatal(lineno, "ENUM_ARG needs a string vector as VALUE");
+
+	if (e->shortopt)
+		utf8_char(e->shortopt, lineno);	// just for the diagnostic
+}
+
+static int
+key_cmp(void const *const a_, void const *const b_)
+{
+	struct key const *const a = a_, *const b = b_;
+	return a->len != b->len ? (a->len > b->len) - (a->len < b->len)
+		: memcmp(a->s, b->s, a->len);
+}
+
+static struct key *
+make_keys(struct entry const *const ents, size_t const nents, size_t *const nkeys)
+/* Returns the long options and negations thereof, without duplicates. A
+   negation that clashes with a real long option loses */
+{
+	struct key * keys = NULL;
+	size_t i, n = 0;
+
+	for (i = 0; i < nents; i++) {
+		size_t const len = ents[i].longopt ? strlen(ents[i].longopt) : 0;
+		if (!len)
+			continue;
+
+		keys = xrealloc(keys, (n + 3) * sizeof *keys);
+		keys[n].s = xrealloc(NULL, len + 1);
+		memcpy(keys[n].s, ents[i].longopt, len + 1);
+		keys[n].len = len, keys[n].opti = i, keys[n].negated = false;
+		n++;
+
+		if (strcmp(ents[i].takes_arg, "NO_ARG") == 0) {
+			/* negated_boolean_longopt() will sort out at runtime
+			   whether this is really a boolean */
+			int j;
+			for (j = 0; j < 2; j++, n++) {
+				char const *const prefix = j ? "no" : "no-";
+				size_t const plen = strlen(prefix);
+				keys[n].s = xrealloc(NULL, plen + len + 1);
+				memcpy(keys[n].s, prefix, plen);
+				memcpy(keys[n].s + plen, ents[i].longopt, len + 1);
+				keys[n].len = plen + len, keys[n].opti = i, keys[n].negated = true;
+			}
+		}
+	}
+
+	if (!n) {
+		*nkeys = 0;
+		return keys;
+	}
+
+	// weed out duplicates, preferring non-negated
+	qsort(keys, n, sizeof *keys, key_cmp);
+	{
+		size_t j = 0;
+		for (i = 0; i < n; i++) {
+			if (j && key_cmp(keys + j - 1, keys + i) == 0) {
+				if (!keys[j - 1].negated && !keys[i].negated)
+					fatal(ents[keys[i].opti].line, "duplicate long option `%s'", keys[i].s);
+				if (keys[j - 1].negated && !keys[i].negated) {
+					free(keys[j - 1].s);
+					keys[j - 1] = keys[i];
+				} else
+					free(keys[i].s);
+				continue;
+			}
+			keys[j++] = keys[i];
+		}
+		n = j;
+	}
+
+	*nkeys = n;
+	return keys;
+}
+
+static int
+key_hash_cmp(void const *const a, void const *const b)
+{
+	uint32_t const x = ((struct key const*)a)->h, y = ((struct key const*)b)->h;
+	return (x > y) - (x < y);
+}
+
+static uint32_t
+hash_keys(struct key *const keys, size_t const nkeys)
+/* Hashes the keys with the first salt under which no two collide, which
+   it returns. At 10,000 options, 0 does about 90% of the time */
+{
+	uint32_t salt;
+	size_t i;
+
+	for (salt = 0; salt < 1000; salt++) {
+		for (i = 0; i < nkeys; i++)
+			keys[i].h = dryopt_hash_salted(keys[i].s, keys[i].len, salt);
+		qsort(keys, nkeys, sizeof *keys, key_hash_cmp);
+		for (i = 1; i < nkeys && keys[i].h != keys[i - 1].h; i++)
+			;
+		if (i >= nkeys)
+			return salt;
+	}
+	fatal(0, "hash collisions under every salt; this shouldn't happen");
+}
+
+struct bucket {
+	size_t first, n;	/* range of keys[] once sorted by bucket */
+	uint32_t i;
+};
+
+static uint32_t const * key_buckets_for_cmp;
+
+static int
+key_bucket_cmp(void const *const a, void const *const b)
+{
+	uint32_t const x = dryopt_rehash(((struct key const*)a)->h, 0) % *key_buckets_for_cmp,
+		y = dryopt_rehash(((struct key const*)b)->h, 0) % *key_buckets_for_cmp;
+	return (x > y) - (x < y);
+}
+
+static int
+bucket_size_cmp(void const *const a, void const *const b)
+// biggest first, since they're hardest to fit
+{
+	size_t const x = ((struct bucket const*)a)->n, y = ((struct bucket const*)b)->n;
+	return (x < y) - (x > y);
+}
+
+static size_t *
+build_phash(struct key *const keys, size_t const nkeys, uint32_t **const seeds_ret,
+		uint32_t *const nseeds_ret)
+/* Hash and displace: split the keys into buckets, then for each bucket in
+   turn, biggest first, find a seed that lands all its keys on free slots.
+   Returns slots[], mapping slot to key index */
+{
+	uint32_t const nseeds = nkeys / 3 + 1;
+	uint32_t * seeds = xrealloc(NULL, nseeds * sizeof *seeds);
+	struct bucket * buckets = xrealloc(NULL, nseeds * sizeof *buckets);
+	size_t * slots = xrealloc(NULL, (nkeys + 1) * sizeof *slots);
+	size_t * scratch = xrealloc(NULL, (nkeys + 1) * sizeof *scratch);
+	size_t i;
+
+	for (i = 0; i < nkeys; i++)
+		slots[i] = (size_t)-1;
+
+	key_buckets_for_cmp = &nseeds;
+	qsort(keys, nkeys, sizeof *keys, key_bucket_cmp);
+
+	for (i = 0; i < nseeds; i++)
+		buckets[i].i = i, buckets[i].n = 0, buckets[i].first = 0, seeds[i] = 0;
+	for (i = 0; i < nkeys; i++) {
+		struct bucket *const b = buckets + dryopt_rehash(keys[i].h, 0) % nseeds;
+		if (!b->n++)
+			b->first = i;
+	}
+	qsort(buckets, nseeds, sizeof *buckets, bucket_size_cmp);
+
+	for (i = 0; i < nseeds && buckets[i].n; i++) {
+		struct bucket const *const b = buckets + i;
+		uint32_t seed;
+
+		for (seed = 1; seed; seed++) {
+			size_t j, k;
+			for (j = 0; j < b->n; j++) {
+				size_t const slot = dryopt_rehash(keys[b->first + j].h, seed) % nkeys;
+				if (slots[slot] != (size_t)-1)
+					break;
+				for (k = 0; k < j; k++)
+					if (scratch[k] == slot)
+						break;
+				if (k < j)
+					break;
+				scratch[j] = slot;
+			}
+			if (j == b->n)
+				break;
+		}
+		if (!seed)
+			fatal(0, "couldn't find a perfect hash; this shouldn't happen");
+
+		seeds[b->i] = seed;
+		{
+			size_t j;
+			for (j = 0; j < b->n; j++)
+				slots[scratch[j]] = b->first + j;
+		}
+	}
+
+	free(buckets);
+	free(scratch);
+	*seeds_ret = seeds, *nseeds_ret = nseeds;
+	return slots;
+}
+
+static void
+emit_table(FILE *const out, char const *const name, struct entry const *const ents, size_t const nents)
+{
+	size_t i;
+
+	fprintf(out, "struct dryopt %s[] = {\n", name);
+	for (i = 0; i < nents; i++) {
+		struct entry const *const e = ents + i;
+		bool const is_enum = strcmp(e->takes_arg, "ENUM_ARG") == 0;
+
+		fputs("\t{ .shortopt = ", out);
+		put_shortopt(out, e);
+		fputs(", .longopt = ", out);
+		put_string(out, e->longopt);
+		fputs(", .helpstr = ", out);
+		put_string(out, e->helpstr);
+
+		if (is_enum)
+			fprintf(out, ",\n\t  .type = ENUM_ARG, .takes_arg = REQ_ARG,"
+				" .sizeof_arg = sizeof *(%s), .argptr = (%s),"
+				" .enum_args = (%s)",
+				e->target, e->target, e->value);
+		else if (strcmp(e->takes_arg, "RANGES") == 0)
+			fprintf(out, ",\n\t  .type = RANGES, .takes_arg = REQ_ARG, .argptr = (%s),"
+				" .nbits = sizeof (%s) / sizeof *(%s) * 64",
+				e->target, e->target, e->target);
+		else
+			fprintf(out, ",\n\t  DRYARG(%s), .takes_arg = %s, .assign_val = {%s}",
+				e->target, e->takes_arg, e->value ? e->value : "0");
+
+		if (e->set_arg)
+			fprintf(out, ", .set_arg = DRYARG_%s", e->set_arg);
+		fputs(" },\n", out);
+	}
+	fputs("};\n\n", out);
+}
+
+static void
+emit_phash(FILE *const out, char const *const name, struct key const *const keys, size_t const nkeys,
+		bool const help)
+{
+	uint32_t * seeds = NULL, nseeds = 0, salt = 0;
+	size_t * slots = NULL, i;
+
+	if (nkeys) {
+		salt = hash_keys((struct key*)keys, nkeys);
+		slots = build_phash((struct key*)keys, nkeys, &seeds, &nseeds);
+	}
+
+	fprintf(out, "static uint32_t const %s_phash_seeds[] = {", name);
+	for (i = 0; i < nseeds; i++)
+		fprintf(out, "%s%s%lu", i ? "," : "", i % 8 ? " " : "\n\t", (unsigned long)seeds[i]);
+	fprintf(out, "%s\n};\n\n", nseeds ? "" : "0");
+
+	fprintf(out, "static struct dryopt_phash_slot const %s_phash_slots[] = {\n", name);
+	for (i = 0; i < nkeys; i++) {
+		struct key const *const k = keys + slots[i];
+		fputs("\t{ ", out);
+		put_string(out, k->s);
+		fprintf(out, ", %zu, %zu, %d },\n", k->len, k->opti, k->negated);
+	}
+	if (!nkeys)
+		fputs("\t{ NULL, 0, 0, 0 }\n", out);
+	fputs("};\n\n", out);
+
+	fprintf(out, "struct dryopt_phash const %s_phash = {\n"
+		"\t%s_phash_seeds, %s_phash_slots, %lu, %lu, %lu, ",
+		name, name, name, (unsigned long)nseeds, (unsigned long)nkeys, (unsigned long)salt);
+	if (help)
+		fprintf(out, "%s_help_text\n};\n\n", name);
+	else
+		fputs("NULL\n};\n\n", out);
+
+	fprintf(out, "#define %s_PARSE(ARGV) dryopt_parse_phash((ARGV), %s,\t\\\n"
+		"\t\tsizeof %s / sizeof *%s, &%s_phash)\n\n",
+		name, name, name, name, name);
+
+	free(seeds);
+	free(slots);
+}
+
+static void
+emit_help_main(FILE *const out, char const *const name, char const *const prog,
+		char const *const args, char const *const extra, char const *const section)
+{
+	fputs("#ifdef DRYOPT_GEN_HELP\n"
+		"int main(int argc, char *argv[])\n"
+		"{\n"
+		"\tstruct dryopt_ctx ctx = DRYOPT_CTX_INIT;\n"
+		"\tFILE * out;\n\n"
+		"\tctx.config.utf8 = 1;\n"
+		"\tctx.prognam = ", out);
+	put_string(out, prog);
+	fprintf(out, ", ctx.help_args = %s, ctx.help_extra = %s;\n\n", args, extra);
+	fprintf(out, "\tif (argc < 2 || !(out = fopen(argv[1], \"w\")))\n"
+		"\t\treturn perror(argc < 2 ? argv[0] : argv[1]), 1;\n"
+		"\tdryopt_help_c(&ctx, %s, sizeof %s / sizeof *%s, \"%s\", out);\n"
+		"\tif (fclose(out))\n"
+		"\t\treturn perror(argv[1]), 1;\n\n"
+		"\tif (argc > 2) {\n"
+		"\t\tif (!(out = fopen(argv[2], \"w\")))\n"
+		"\t\t\treturn perror(argv[2]), 1;\n"
+		"\t\tdryopt_man_r(&ctx, %s, sizeof %s / sizeof *%s, ",
+		name, name, name, name, name, name, name);
+	put_string(out, section);
+	fputs(", out);\n"
+		"\t\tif (fclose(out))\n"
+		"\t\t\treturn perror(argv[2]), 1;\n"
+		"\t}\n"
+		"\treturn 0;\n"
+		"}\n"
+		"#else\n", out);
+}
+
+int
+main(int argc __attribute__((unused)), char *const argv[])
+{
+	struct dryopt opts[] = {
+		DRYOPT(L'o', "output", "Write to FILE rather than stdout",
+			REQ_ARG, &outfile, 0)
+	};
+	FILE * in = stdin, * out = stdout;
+	char * buf, * line, * next, * prologue = NULL, * epilogue = NULL;
+	char const * name = "opts", * help = NULL, * prog = NULL, * args = "NULL",
+		* extra = "NULL", * section = "1";
+	char * arg;
+	struct entry * ents = NULL;
+	struct key * keys;
+	size_t nents = 0, nkeys, i;
+	unsigned long lineno = 0, prologue_lines = 0;
+	bool in_prologue = false;
+
+	DRYopt_help_args = "[SPEC]";
+	DRYopt_help_extra = "Generate C for a struct dryopt[] and its perfect hash from SPEC";
+	argv += DRYOPT_PARSE(argv, opts);
+
+	if (*argv && strcmp(infile = *argv, "-") && !(in = fopen(infile, "r")))
+		fatal(0, "%s: %s", infile, strerror(errno));
+	buf = slurp(in);
+
+	for (line = buf; line; line = next) {
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		lineno++;
+
+		if (in_prologue) {
+			if (strcmp(line, "%}") == 0)
+				in_prologue = false;
+			else
+				prologue_lines++;
+			continue;
+		}
+
+		if (strcmp(line, "%{") == 0) {
+			in_prologue = true;
+			prologue = next;
+			continue;
+		}
+
+		if (strcmp(line, "%%") == 0) {
+			epilogue = next;
+			break;
+		}
+
+		if ((arg = directive(line, "name", lineno))) {
+			name = arg;
+			continue;
+		}
+		if ((arg = directive(line, "help", lineno))) {
+			help = arg;
+			continue;
+		}
+		if ((arg = directive(line, "prog", lineno))) {
+			prog = arg;
+			continue;
+		}
+		if ((arg = directive(line, "args", lineno))) {
+			args = arg;
+			continue;
+		}
+		if ((arg = directive(line, "extra", lineno))) {
+			extra = arg;
+			continue;
+		}
+		if ((arg = directive(line, "section", lineno))) {
+			section = arg;
+			continue;
+		}
+
+		if (!*line || *line == '#')
+			continue;
+
+		ents = xrealloc(ents, (nents + 1) * sizeof *ents);
+		parse_entry(line, lineno, ents + nents++);
+	}
+
+	if (in_prologue)
+		fatal(lineno, "unterminated %%{");
+
+	if (outfile && !(out = fopen(outfile, "w")))
+		fatal(0, "%s: %s", outfile, strerror(errno));
+
+	fprintf(out, "/* Generated by dryopt-gen from %s; do not edit */\n\n",
+		strcmp(infile, "-") ? infile : "stdin");
+	// the prologue has had its newlines nobbled by the loop above
+	for (line = prologue; prologue_lines--; line += strlen(line) + 1)
+		fprintf(out, "%s\n", line);
+	if (prologue)
+		putc('\n', out);
+
+	keys = make_keys(ents, nents, &nkeys);
+	emit_table(out, name, ents, nents);
+
+	// the help program has no help text yet, so no phash either
+	if (help) {
+		char *const prog_buf = prog ? NULL : default_prog(infile);
+		emit_help_main(out, name, prog ? prog : prog_buf, args, extra, section);
+		free(prog_buf);
+		fputs("#include ", out);
+		put_string(out, help);
+		fputs("\n\n", out);
+	}
+	emit_phash(out, name, keys, nkeys, help);
+
+	if (epilogue)
+		fputs(epilogue, out);
+
+	if (help)
+		fputs("#endif /* DRYOPT_GEN_HELP */\n", out);
+
+	if (fflush(out) || ferror(out))
+		fatal(0, "%s: %s", outfile ? outfile : "stdout", strerror(errno));
+
+	for (i = 0; i < nkeys; i++)
+		free(keys[i].s);
+	free(keys);
+	free(ents);
+	free(buf);
+	return 0;
+}
@@ -12,67 +12,187 @@ GNU C:	variadic macro fallback, enum bitfields (widely available and
 	probably a WONTFIX)
 */
 
+/* For mmap(2) of response files. Anonymous mappings aren't POSIX (until
+   2024), so ask for them specially */
+#if !defined _POSIX_C_SOURCE && !defined _XOPEN_SOURCE
+#  define _POSIX_C_SOURCE 200809L
+#endif
+#define _DEFAULT_SOURCE 1
+#define _DARWIN_C_SOURCE 1
+
 #include "dryopt.h"
 
 #include <assert.h>
-#include <ctype.h>	/* isspace(3) */
 #include <errno.h>
 #include <float.h>
 #include <limits.h>
-#include <locale.h>
+#include <locale.h>	/* setlocale(3), localeconv(3) */
 #include <math.h>	/* isfinite(3) */
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>	/* offsetof */
+#include <stdint.h>	/* uintptr_t */
 #include <stdio.h>
-#include <stdlib.h>	/* exit(3), strtou?ll(3), abort(3); planned: bsearch(3), qsort(3) */
+#include <stdlib.h>	/* exit(3), strtod(3), abort(3), bsearch(3), qsort(3) */
 #include <string.h>
-#include <wchar.h>	/* mbrtowc(3), wcrtomb(3) */
+#include <time.h>	/* clock_gettime(2), for dryopt_stats.timing */
+#include <wchar.h>	/* mbrtowc(3), wcrtomb(3), WCHAR_MAX */
+
+#if defined __unix__ || defined __unix || (defined __APPLE__ && defined __MACH__)
+#  include <unistd.h>
+#endif
+#if defined _POSIX_MAPPED_FILES && _POSIX_MAPPED_FILES > 0
+#  include <fcntl.h>	/* open(2) */
+#  include <sys/mman.h>
+#  include <sys/stat.h>	/* fstat(2) */
+#  if !defined MAP_ANONYMOUS && defined MAP_ANON
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#  ifdef MAP_ANONYMOUS
+#    define HAVE_MMAP 1
+#  endif
+#endif
+#if defined __GNUC__ && defined __SSE2__
+#  include <emmintrin.h>	/* for scan_name() */
+#  define SCAN_SSE2 1
+#elif defined __GNUC__ && defined __aarch64__ && defined __ARM_NEON
+#  include <arm_neon.h>
+#  define SCAN_NEON 1
+#endif
+#if defined _POSIX_THREADS && _POSIX_THREADS > 0 && !defined DRYOPT_NO_THREADS
+#  include <pthread.h>	/* for dryopt_parse_operands() */
+#  define HAVE_PTHREADS 1
+#endif
 
 // global defaults
 char const	*restrict prognam = NULL,
 		*restrict DRYopt_help_args = NULL,
 		*restrict DRYopt_help_extra = NULL;
 struct dryopt_config_s dryopt_config = { .wrap = 80 };
+struct dryopt_stats * DRYopt_stats = NULL;
+dryopt_trace DRYopt_trace = NULL;
+void * DRYopt_trace_data = NULL;
 
-#if 0
 static int
-dryopt_cmp(struct dryopt const *restrict const a, struct dryopt const *restrict const b)
+dryopt_cmp(void const *const a_, void const *const b_)
+/* qsort(3) comparator for dryopt_config.sorting: by longopt, with entries
+   lacking one at the end, where bsearch(3) won't be looking */
 {
-	if (a->shortopt || b->shortopt)
-		/* is it possible this might overflow? What if it does, does
-		   it preserve the sign or wrap around? */
-		return b->shortopt - a->shortopt;
+	struct dryopt const *const a = a_, *const b = b_;
 
-	if (a->longopt && b->longopt)
-		return strcmp(a->longopt, b->longopt);
+	if (!a->longopt || !b->longopt)
+		return !a->longopt - !b->longopt;
 
-	return 0; /* default */
+	return strcmp(a->longopt, b->longopt);
+}
+
+static void
+sort_opts(struct dryopt_ctx const *const ctx, struct dryopt opts[], size_t const optn)
+/* For do_sort, unless they're in order already, which takes one pass to
+   tell. The config is left alone: the next table it's used for may not be */
+{
+	size_t i;
+
+	if (ctx->config.sorting != do_sort)
+		return;
+	for (i = 1; i < optn && dryopt_cmp(opts + i - 1, opts + i) <= 0; i++)
+		;
+	if (i < optn)
+		qsort(opts, optn, sizeof *opts, dryopt_cmp);
+}
+
+static int
+longopt_cmp(void const *const key, void const *const opt)
+{
+	return strcmp(key, ((struct dryopt const*)opt)->longopt);
+}
+
+// The same again for arrays of pointers, as in struct dryopt_compiled
+static int
+dryopt_ptr_cmp(void const *const a, void const *const b)
+{
+	return dryopt_cmp(*(struct dryopt const *const *)a, *(struct dryopt const *const *)b);
+}
+
+static int
+longidx_cmp(void const *const key, void const *const opt)
+{
+	return strcmp(key, (*(struct dryopt const *const *)opt)->longopt);
 }
-#endif
 
-static void __attribute__((cold, format(__printf__, 1, 2)))
-err_(const char *restrict const fmt, ...)
+static void __attribute__((cold, format(__printf__, 2, 3)))
+err_(struct dryopt_ctx *restrict const ctx, const char *restrict const fmt, ...)
 {
 	va_list va;
 
-	dryopt_config.mistakes_were_made = 1;
+	ctx->config.mistakes_were_made = 1;
 
-	if (dryopt_config.autodie == noop)
+	if (ctx->config.autodie == noop)
 		return;
 
 	va_start(va, fmt);
 	vfprintf(stderr, fmt, va);
 	va_end(va);
 
-	if (dryopt_config.autodie == die)
+	if (ctx->config.autodie == die)
 		exit(EXIT_FAILURE);
 }
 
+/* These expect a struct dryopt_ctx * called ctx in scope */
 #if __STDC_VERSION__ < 199900l && defined __GNUC__
-#  define ERR(fmt, args...) err_("%s: " fmt "\n", prognam, args)
+#  define ERR(fmt, args...) err_(ctx, "%s: " fmt "\n", ctx->prognam, args)
 #else
-#  define ERR(fmt, ...) err_("%s: " fmt "\n", prognam, __VA_ARGS__)
+#  define ERR(fmt, ...) err_(ctx, "%s: " fmt "\n", ctx->prognam, __VA_ARGS__)
+#endif
+
+static uint64_t
+stats_clock(struct dryopt_ctx const *const ctx)
+/* Nanoseconds, from whenever; 0 if ctx isn't timing */
+{
+	if (!ctx->stats || !ctx->stats->timing)
+		return 0;
+#if defined _POSIX_TIMERS && _POSIX_TIMERS > 0 && defined CLOCK_MONOTONIC
+	{
+		struct timespec ts;
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+			return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
 #endif
+	return clock() * (1000000000ull / CLOCKS_PER_SEC);
+}
+
+/* Instrumentation, for ctx->stats if there are any. Also expecting ctx */
+#define STAT_ADD(FIELD, N) do if (ctx->stats) ctx->stats->FIELD += (N); while (0)
+#define TIMED(FIELD, STMT) do {						\
+		uint64_t const start_ = stats_clock(ctx);		\
+		STMT;							\
+		if (start_)						\
+			ctx->stats->FIELD += stats_clock(ctx) - start_;	\
+	} while (0)
+
+static void
+resolved(struct dryopt_ctx *const ctx, struct dryopt const *const opt,
+		enum dryopt_form const form, char const *const arg)
+{
+	if (ctx->stats)
+		switch (form) {
+		case DRYOPT_SHORT:	ctx->stats->shorts++; break;
+		case DRYOPT_LONG:	ctx->stats->longs++; break;
+		case DRYOPT_NEGATED:	ctx->stats->negated++; break;
+		}
+	if (ctx->trace)
+		ctx->trace(ctx->trace_data, opt, form, arg);
+}
+
+static unsigned __attribute__((__const__))
+bsearch_probes(size_t n)
+// the most strcmp(3)s bsearch(3) will do over n
+{
+	unsigned i = 0;
+	for (; n; n >>= 1)
+		i++;
+	return i;
+}
 
 #define ENUM_MAP_ENTRY(enum_val) [enum_val] = #enum_val
 static char const *__attribute__((__const__, returns_nonnull))
@@ -80,16 +200,17 @@ enum_type2str(enum dryarg_tag const tag)
 {
 	/* Array size specified, so in the unlikely event that some borked compiler
 	   decides to make enum values non-linear, we at least get a warning */
-	static char const *restrict table[FLOATING + 1] = {
+	static char const *restrict table[RANGES + 1] = {
 		NULL, // DRYOPT_INVALID
 		ENUM_MAP_ENTRY(STR),
 		ENUM_MAP_ENTRY(CHAR),
 		ENUM_MAP_ENTRY(SIGNED),
 		ENUM_MAP_ENTRY(UNSIGNED),
-		ENUM_MAP_ENTRY(FLOATING)
+		ENUM_MAP_ENTRY(FLOATING),
+		ENUM_MAP_ENTRY(RANGES)
 	};
 
-	return tag >= sizeof table / sizeof *table ? "" : table[tag];
+	return tag >= sizeof table / sizeof *table || !table[tag] ? "" : table[tag];
 }
 
 static bool __attribute__((__const__))
@@ -104,15 +225,11 @@ is_strictly_defined(enum dryarg_tag const type)
 	}
 }
 
-static int __attribute__((format(__printf__, 2, 3), nonnull(2)))
-print_row_printf_helper(FILE * out, char const * fmt, ...)
+static int __attribute__((pure))
+takes_arg(struct dryopt const *const opt)
+// ENUM_ARG and RANGES always take an argument, whatever .takes_arg says
 {
-	int ret;
-	va_list va;
-	va_start(va, fmt);
-	ret = out ? vfprintf(out, fmt, va) : vsnprintf(NULL, 0, fmt, va);
-	va_end(va);
-	return ret;
+	return opt->type == ENUM_ARG || opt->type == RANGES ? REQ_ARG : opt->takes_arg;
 }
 
 static bool __attribute__((pure))
@@ -124,144 +241,532 @@ opt_is_boolean(struct dryopt const *const opt)
 		    || opt->set_arg == DRYARG_OR);
 }
 
-static int __attribute__((nonnull(1)))
-print_help_entry(struct dryopt const *restrict const opt, FILE *restrict const out)
+static int
+utf8_decode(wchar_t *restrict const wc, char const *restrict const s)
+/* Like mbrtowc(3) in a UTF-8 locale, but without needing one, and returns
+   0 at the end of the string. No state, since a whole sequence is read at
+   once. Overlong forms, surrogates and anything wchar_t can't hold are
+   EILSEQ */
+{
+	unsigned char const *const u = (unsigned char const*)s;
+	unsigned long c;
+	int n, i;
+
+	if (u[0] < 0x80) {
+		*wc = u[0];
+		return !!u[0];
+	}
+
+	if (u[0] < 0xc2)	goto bad;	/* continuation, or overlong */
+	else if (u[0] < 0xe0)	c = u[0] & 0x1f, n = 2;
+	else if (u[0] < 0xf0)	c = u[0] & 0x0f, n = 3;
+	else if (u[0] < 0xf5)	c = u[0] & 0x07, n = 4;
+	else			goto bad;
+
+	// stops at a NUL, since that isn't a continuation byte
+	for (i = 1; i < n; i++) {
+		if ((u[i] & 0xc0) != 0x80)
+			goto bad;
+		c = c << 6 | (u[i] & 0x3f);
+	}
+
+	if ((n == 3 && c < 0x800) || (n == 4 && (c < 0x10000 || c > 0x10ffff))
+	    || (c >= 0xd800 && c <= 0xdfff) || c > (unsigned long)WCHAR_MAX)
+		goto bad;
+
+	*wc = (wchar_t)c;
+	return n;
+
+bad:
+	errno = EILSEQ;
+	return -1;
+}
+
+static size_t
+utf8_encode(char *restrict const buf, unsigned long const c)
+{
+	if (c < 0x80) {
+		buf[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800) {
+		buf[0] = (char)(0xc0 | c >> 6);
+		buf[1] = (char)(0x80 | (c & 0x3f));
+		return 2;
+	}
+	if (c < 0x10000) {
+		buf[0] = (char)(0xe0 | c >> 12);
+		buf[1] = (char)(0x80 | (c >> 6 & 0x3f));
+		buf[2] = (char)(0x80 | (c & 0x3f));
+		return 3;
+	}
+	buf[0] = (char)(0xf0 | c >> 18);
+	buf[1] = (char)(0x80 | (c >> 12 & 0x3f));
+	buf[2] = (char)(0x80 | (c >> 6 & 0x3f));
+	buf[3] = (char)(0x80 | (c & 0x3f));
+	return 4;
+}
+
+#define SHORTOPT_MB_MAX (MB_LEN_MAX > 4 ? MB_LEN_MAX : 4)
+static char *
+shortopt_mb(bool const utf8, wchar_t const wc, char buf[SHORTOPT_MB_MAX + 1])
+/* The multibyte form of a short option, for printing with %s rather than
+   %lc so that utf8 mode needn't go near the locale. Returns buf */
+{
+	size_t len;
+
+	if (utf8)
+		len = utf8_encode(buf, (unsigned long)wc);
+	else {
+		mbstate_t ps = {0};
+		if ((len = wcrtomb(buf, wc, &ps)) == (size_t)-1)
+			len = 0;
+	}
+
+	buf[len] = '\0';
+	return buf;
+}
+
+/* Help is rendered into a buffer, which is written out when full, or (with
+   no FILE) just counts what didn't fit, like snprintf(3). One buffer's
+   worth is usually all of it, so that's one write */
+struct help_buf {
+	char * buf;
+	size_t size, len;
+	FILE * out;
+	void (*write)(char const *, size_t, FILE *);	/* NULL for fwrite(3) */
+};
+
+static void
+hb_flush(struct help_buf *const hb)
+{
+	if (hb->out && hb->len) {
+		if (hb->write)
+			hb->write(hb->buf, hb->len, hb->out);
+		else
+			fwrite(hb->buf, 1, hb->len, hb->out);
+	}
+	hb->len = 0;
+}
+
+static void
+hb_write(struct help_buf *const hb, char const *s, size_t n)
+{
+	for (;;) {
+		size_t const room = hb->len < hb->size ? hb->size - hb->len : 0;
+		size_t const k = n < room ? n : room;
+		if (k)
+			memcpy(hb->buf + hb->len, s, k);
+		hb->len += k, s += k, n -= k;
+		if (!n)
+			return;
+		if (!hb->out) {
+			hb->len += n;
+			return;
+		}
+		hb_flush(hb);
+	}
+}
+
+static void
+hb_puts(struct help_buf *const hb, char const *const s)
+{
+	hb_write(hb, s, strlen(s));
+}
+
+static void
+hb_pad(struct help_buf *const hb, unsigned n)
+{
+	static char const spaces[] = "                ";
+	for (; n > sizeof spaces - 1; n -= sizeof spaces - 1)
+		hb_write(hb, spaces, sizeof spaces - 1);
+	hb_write(hb, spaces, n);
+}
+
+static size_t
+mb_step(char const *const s, bool const utf8, mbstate_t *const ps)
+// bytes in the (non-NUL) character at s; 1 if it's invalid
+{
+	size_t len;
+
+	if (utf8) {
+		for (len = 1; ((unsigned char)s[len] & 0xc0) == 0x80; len++)
+			;
+		return len;
+	}
+#ifndef __STDC_MB_MIGHT_NEQ_WC__
+	// as in parse_shortopts()
+	if (*s >= ' ' && *s < 0x7f && mbsinit(ps))
+		return 1;
+#endif
+	len = mbrlen(s, MB_CUR_MAX, ps);
+	if (len == (size_t)-1 || len == (size_t)-2 || !len) {
+		memset(ps, 0, sizeof *ps);
+		return 1;
+	}
+	return len;
+}
+
+static unsigned
+mb_columns(char const *const s, bool const utf8)
+/* assume one column per character, not per byte */
 {
-	wchar_t const shortopt_buf[3] = { L'-' * !!opt->shortopt, opt->shortopt, L'\0' };
-//	int const unseen_bytes = wcstombs(NULL, shortopt_buf, 0) - wcslen(shortopt_buf);
 	mbstate_t ps = {0};
-	int const unseen_bytes = opt->shortopt ? wcrtomb(NULL, opt->shortopt, &ps) - 1 : 0;
+	size_t i;
+	unsigned cols = 0;
+	for (i = 0; s[i]; i += mb_step(s + i, utf8, &ps))
+		cols++;
+	return cols;
+}
+
+static unsigned
+help_put(struct help_buf *const hb, char const *const s, bool const utf8)
+// prints s, or with hb == NULL, returns its width instead
+{
+	if (!hb)
+		return mb_columns(s, utf8);
+	hb_puts(hb, s);
+	return 0;
+}
+
+static unsigned
+help_entry(struct help_buf *const hb, struct dryopt const *restrict const opt,
+		bool const utf8)
+/* The `  -o, --option=[ARG]' part of opt's entry, or with hb == NULL, its
+   width, and nothing printed */
+{
+	char shortopt_buf[SHORTOPT_MB_MAX + 1];
 	char const argsep[2] = {
-		opt->takes_arg && opt->longopt
+		takes_arg(opt) && opt->longopt
 		? '='
-		: opt->takes_arg == REQ_ARG || (opt->takes_arg == OPT_ARG && is_strictly_defined(opt->type))
+		: takes_arg(opt) == REQ_ARG || (takes_arg(opt) == OPT_ARG && is_strictly_defined(opt->type))
 			? ' '
 			: '\0',
 		'\0'
 	};
-	int ret = print_row_printf_helper (out,
-		"  %ls%s%s%s%s%s",
-		shortopt_buf,
-		opt->shortopt && opt->longopt ? ", " : "",
-		opt->longopt ? opt_is_boolean(opt) ? "--[no-]" : "--" : "",
-		opt->longopt ? opt->longopt : "",
-		argsep,
-		opt->takes_arg == OPT_ARG ? "[" : ""
-	);
+	unsigned width = help_put(hb, "  ", utf8);
+
+	if (opt->shortopt) {
+		width += help_put(hb, "-", utf8);
+		width += help_put(hb, shortopt_mb(utf8, opt->shortopt, shortopt_buf), utf8);
+		if (opt->longopt)
+			width += help_put(hb, ", ", utf8);
+	}
+	if (opt->longopt) {
+		width += help_put(hb, opt_is_boolean(opt) ? "--[no-]" : "--", utf8);
+		width += help_put(hb, opt->longopt, utf8);
+	}
+	width += help_put(hb, argsep, utf8);
+	if (takes_arg(opt) == OPT_ARG)
+		width += help_put(hb, "[", utf8);
 
 	if (opt->type == ENUM_ARG) {
 		size_t i = 0;
-		for (; opt->enum_args[i]; i++)
-			ret += print_row_printf_helper(out, "%s%s", i ? "," : "", opt->enum_args[i]);
-	} else if (opt->takes_arg)
-		ret += print_row_printf_helper(out, "%s%s",
-			opt->type == CALLBACK ? "ARG" : enum_type2str(opt->type),
-			opt->takes_arg == OPT_ARG ? "]" : "");
+		for (; opt->enum_args[i]; i++) {
+			if (i)
+				width += help_put(hb, ",", utf8);
+			width += help_put(hb, opt->enum_args[i], utf8);
+		}
+	} else if (takes_arg(opt)) {
+		width += help_put(hb, opt->type == CALLBACK ? "ARG" : enum_type2str(opt->type), utf8);
+		if (takes_arg(opt) == OPT_ARG)
+			width += help_put(hb, "]", utf8);
+	}
 	// else no arg
 
-	if (unseen_bytes > 0)
-		ret -= unseen_bytes;
-
-	return ret;
+	return width;
 }
 
-static int
-break_space(char const *const s, unsigned offset)
-/* Looks for a space at which to break the string. Starts at offset
-   (ie. length until the margin line) and looks backwards; if unsuccessful,
-   looks forwards instead for the rest of the string. Returns the length of
-   string to print, which may be the whole thing. `unsigned' is to avoid
-   unnecessary sign extension for indices, but the type returned is within
-   [0, INT_MAX], so it can be passed to printf(3) */
+static bool
+is_break(char const c)
 {
-	unsigned const og_offset = offset;
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
 
-	{
-		char const *const t = memchr(s, 0, offset);
-		if (t)
-			return t - s; // bounded by offset, so no risk of overflow
+static size_t
+break_line(char const *const s, unsigned const width, bool const utf8)
+/* How many bytes of s make the next line: all of it if it fits in width
+   columns, otherwise up to the last space that fits, or failing that (one
+   long word), up to the first space after it */
+{
+	mbstate_t ps = {0};
+	size_t i, space = 0;
+	unsigned cols = 0;
+
+	for (i = 0; s[i]; i += mb_step(s + i, utf8, &ps), cols++) {
+		bool const at_space = is_break(s[i]);
+		if (at_space && i && cols <= width)
+			space = i;
+		else if (cols >= width && (space || at_space))
+			return space ? space : i;
 	}
 
-	do
-		if (isspace(s[offset]))
-			return offset;
-	while (--offset);
+	return cols <= width || !space ? i : space;
+}
+
+static void
+wrap_help_text(struct help_buf *const hb, char const *restrict help_text,
+		unsigned const lmargin, unsigned const rmargin, unsigned const already_printed,
+		bool const utf8)
+{
+	hb_pad(hb, lmargin > already_printed ? lmargin - already_printed : 1);
+	if (rmargin < lmargin) {
+		hb_puts(hb, help_text);
+		hb_write(hb, "\n", 1);
+		return;
+	}
 
-	offset = og_offset;
-	while (offset++ < INT_MAX && s[offset] && !isspace(offset));
-	return offset;
+	for (;;) {
+		size_t const n = break_line(help_text, rmargin - lmargin, utf8);
+		hb_write(hb, help_text, n);
+		hb_write(hb, "\n", 1);
+		if (!*(help_text += n))
+			break;
+		help_text++;	// the space broken at
+		hb_pad(hb, lmargin);
+	}
 }
 
-static void __attribute__((nonnull))
-wrap_help_text(FILE *restrict const out, char const *restrict help_text,
-		unsigned const lmargin, unsigned const rmargin, unsigned const already_printed)
+/* Entry widths kept from the measuring pass, so that printing needn't count
+   columns again; entries past this many are measured twice */
+#define HELP_WIDTHS_MAX 256
+
+static void
+render_help(struct help_buf *const hb, struct dryopt_ctx const *restrict const ctx,
+		struct dryopt const opts[], size_t const optn)
 {
-	int break_offset;
+	static char const help_entry_str[] = "  -h, -?, --help";
+	bool const utf8 = ctx->config.utf8;
+	unsigned len = sizeof help_entry_str - 1, widths[HELP_WIDTHS_MAX];
+	size_t i;
 
-	/* everything before the loop is just an extended first iteration
-	   of the loop, accounting for factors that become nonexistent in
-	   subsequent iterations (like already_printed) */
+	// measure: find longest entry string (`  -o, --option=[ARG]')
+	for (i = 0; i < optn; i++) {
+		unsigned const l = help_entry(NULL, opts + i, utf8);
+		if (i < HELP_WIDTHS_MAX)
+			widths[i] = l;
+		if (len < l)
+			len = l;
+	}
 
-	fprintf(out, "%*s", lmargin > already_printed ? lmargin - already_printed : 0, " ");
-	if (rmargin < lmargin) {
-		fprintf(out, "%s\n", help_text);
-		return;
+	hb_puts(hb, "Usage: ");
+	hb_puts(hb, ctx->prognam ? ctx->prognam : "");
+	hb_puts(hb, " [OPTS] ");
+	hb_puts(hb, ctx->help_args ? ctx->help_args : "[ARGS]");
+	hb_write(hb, "\n", 1);
+
+	if (ctx->help_extra) {
+		hb_puts(hb, ctx->help_extra);
+		hb_write(hb, "\n", 1);
+	}
+
+	for (i = 0; i < optn; i++) {
+		unsigned const printed = i < HELP_WIDTHS_MAX
+			? widths[i]
+			: help_entry(NULL, opts + i, utf8);
+		help_entry(hb, opts + i, utf8);
+		if (opts[i].helpstr)
+			wrap_help_text(hb, opts[i].helpstr, len + 3, ctx->config.wrap, printed, utf8);
+		else
+			hb_write(hb, "\n", 1);
 	}
 
-	break_offset = break_space(help_text, rmargin - lmargin);
-	fprintf(out, "%.*s\n", break_offset, help_text);
+	hb_puts(hb, help_entry_str);
+	wrap_help_text(hb, "Print this help and exit", len + 3,
+			ctx->config.wrap, sizeof help_entry_str - 1, utf8);
+}
+
+extern size_t
+dryopt_help_render(struct dryopt_ctx const *restrict const ctx,
+		struct dryopt const opts[], size_t const optn, char *const buf, size_t const size)
+{
+	struct help_buf hb = { buf, size ? size - 1 : 0, 0, NULL, NULL };
+	render_help(&hb, ctx, opts, optn);
+	if (size)
+		buf[hb.len < size ? hb.len : size - 1] = '\0';
+	return hb.len;
+}
 
-	while (*(help_text += break_offset)) {
-		help_text++;	/* if it gets past the above test,
-				   !!isspace(*help_text), so skip it */
-		break_offset = break_space(help_text, rmargin - lmargin);
-		fprintf(out, "%*s%.*s\n", lmargin, " ", break_offset, help_text);
+static void
+help_write(char const *s, size_t n, FILE *restrict const outfile)
+/* all of s in one write(2) where there is one, past stdio, which would
+   otherwise split it at its own buffer size */
+{
+#ifdef _POSIX_VERSION
+	int const fd = fileno(outfile);
+	fflush(outfile);
+	if (fd >= 0) {
+		while (n) {
+			ssize_t const w = write(fd, s, n);
+			if (w < 0 && errno == EINTR)
+				continue;
+			if (w <= 0)
+				return;
+			s += w, n -= (size_t)w;
+		}
+		return;
 	}
+#endif
+	fwrite(s, 1, n, outfile);
+	fflush(outfile);
 }
 
 extern void __attribute__((cold, leaf))
-auto_help (
-	struct dryopt opts[],
+auto_help_r (
+	struct dryopt_ctx const *restrict const ctx,
+	struct dryopt const opts[],
 	size_t const optn,
 	FILE *restrict const outfile
 ) {
-	static char const help_entry[] = "  -h, -?, --help";
-	int len = sizeof help_entry - 1;
-	size_t i;
+	char buf[8192];
+	struct help_buf hb = { buf, sizeof buf, 0, NULL, NULL };
 
-	// first pass: find longest entry string (`  -o, --option=[ARG]')
-	for (i = 0; i < optn; i++) {
-		int l;
-		/* also cheekily fix ENUM_ARG entries */
-		if (opts[i].type == ENUM_ARG)
-			opts[i].takes_arg = REQ_ARG;
-		if (len < (l = print_help_entry(opts + i, NULL)))
-			len = l;
+	if (ctx->help_text) {
+		// precomputed by dryopt_help_c()
+		help_write(ctx->help_text, strlen(ctx->help_text), outfile);
+		return;
 	}
 
-	fprintf(outfile, "Usage: %s [OPTS] %s\n",
-		prognam, DRYopt_help_args ? DRYopt_help_args : "[ARGS]");
+	render_help(&hb, ctx, opts, optn);
+	if (hb.len <= sizeof buf) {
+		help_write(buf, hb.len, outfile);
+		return;
+	}
+	// too big for one buffer: render it again, a bufferful at a time
+	hb.len = 0, hb.out = outfile;
+	render_help(&hb, ctx, opts, optn);
+	hb_flush(&hb);
+	fflush(outfile);
+}
 
-	if (DRYopt_help_extra)
-		fprintf(outfile, "%s\n", DRYopt_help_extra);
+static void
+write_c_string(char const *const s, size_t const n, FILE *const out)
+// the inside of a C string literal, breaking it at newlines
+{
+	size_t i;
+	for (i = 0; i < n; i++)
+		switch (s[i]) {
+		case '"': case '\\':
+			fprintf(out, "\\%c", s[i]);
+			break;
+		case '\n':
+			fputs("\\n\"\n\t\"", out);
+			break;
+		default:
+			/* octal escapes are at most three digits, unlike hex
+			   ones, so can't swallow what follows */
+			if ((unsigned char)s[i] < ' ' || s[i] == 0x7f)
+				fprintf(out, "\\%03o", (unsigned char)s[i]);
+			else
+				putc(s[i], out);
+		}
+}
 
-	// second pass: actually print
-	for (i = 0; i < optn; i++) {
-		int const printed = print_help_entry(opts + i, outfile);
-		if (printed < 0) {
-			perror(prognam);
-			continue;
+extern void __attribute__((cold))
+dryopt_help_c(struct dryopt_ctx const *restrict const ctx, struct dryopt const opts[],
+		size_t const optn, char const *const ident, FILE *restrict const out)
+{
+	char buf[8192];
+	struct help_buf hb = { buf, sizeof buf, 0, out, write_c_string };
+
+	fprintf(out, "static char const %s_help_text[] =\n\t\"", ident);
+	render_help(&hb, ctx, opts, optn);
+	hb_flush(&hb);
+	fputs("\";\n", out);
+}
+
+static void
+man_puts(FILE *restrict const out, char const *s)
+/* roff-escaped; also for the start of a line */
+{
+	if (*s == '.' || *s == '\'')
+		fputs("\\&", out);
+	for (; *s; s++)
+		switch (*s) {
+		case '\\':	fputs("\\e", out); break;
+		case '-':	fputs("\\-", out); break;
+		case '\n':
+			putc('\n', out);
+			if (s[1] == '.' || s[1] == '\'')
+				fputs("\\&", out);
+			break;
+		default:	putc(*s, out);
 		}
+}
 
-		if (opts[i].helpstr)
-			wrap_help_text(outfile, opts[i].helpstr, len + 3, dryopt_config.wrap, printed);
-		else
-			fputc('\n', outfile);
+extern void __attribute__((cold))
+dryopt_man_r(struct dryopt_ctx const *restrict const ctx, struct dryopt const opts[],
+		size_t const optn, char const *const section, FILE *restrict const out)
+{
+	bool const utf8 = ctx->config.utf8;
+	char const *const name = ctx->prognam ? ctx->prognam : "";
+	size_t i;
+
+	fputs(".TH ", out);
+	man_puts(out, name);
+	fprintf(out, " %s\n.SH NAME\n", section);
+	man_puts(out, name);
+	if (ctx->help_extra) {
+		fputs(" \\- ", out);
+		man_puts(out, ctx->help_extra);
+	}
+	fputs("\n.SH SYNOPSIS\n.B ", out);
+	man_puts(out, name);
+	fputs("\n[OPTS] ", out);
+	man_puts(out, ctx->help_args ? ctx->help_args : "[ARGS]");
+	fputs("\n.SH OPTIONS\n", out);
+
+	for (i = 0; i < optn; i++) {
+		struct dryopt const *const opt = opts + i;
+		char shortopt_buf[SHORTOPT_MB_MAX + 1];
+
+		fputs(".TP\n", out);
+		if (opt->shortopt) {
+			fputs("\\fB\\-", out);
+			man_puts(out, shortopt_mb(utf8, opt->shortopt, shortopt_buf));
+			fputs(opt->longopt ? "\\fR, " : "\\fR", out);
+		}
+		if (opt->longopt) {
+			fputs(opt_is_boolean(opt) ? "\\fB\\-\\-\\fR[\\fBno\\-\\fR]\\fB" : "\\fB\\-\\-", out);
+			man_puts(out, opt->longopt);
+			fputs("\\fR", out);
+		}
+		if (takes_arg(opt)) {
+			size_t j;
+			fputs(opt->longopt ? "=" : " ", out);
+			if (takes_arg(opt) == OPT_ARG)
+				putc('[', out);
+			fputs("\\fI", out);
+			if (opt->type == ENUM_ARG)
+				for (j = 0; opt->enum_args[j]; j++) {
+					if (j)
+						putc(',', out);
+					man_puts(out, opt->enum_args[j]);
+				}
+			else
+				fputs(opt->type == CALLBACK ? "ARG" : enum_type2str(opt->type), out);
+			fputs("\\fR", out);
+			if (takes_arg(opt) == OPT_ARG)
+				putc(']', out);
+		}
+		putc('\n', out);
+		if (opt->helpstr)
+			man_puts(out, opt->helpstr);
+		putc('\n', out);
 	}
 
-	fputs(help_entry, outfile);
-	wrap_help_text(outfile, "Print this help and exit", len + 3,
-			dryopt_config.wrap, sizeof help_entry - 1);
+	fputs(".TP\n\\fB\\-h\\fR, \\fB\\-?\\fR, \\fB\\-\\-help\\fR\n"
+		"Print this help and exit\n", out);
+}
+
+extern void __attribute__((cold, leaf))
+auto_help(struct dryopt opts[], size_t const optn, FILE *restrict const outfile)
+{
+	struct dryopt_ctx const ctx = {
+		dryopt_config, prognam, DRYopt_help_args, DRYopt_help_extra,
+		NULL, DRYopt_stats, DRYopt_trace, DRYopt_trace_data
+	};
+	auto_help_r(&ctx, opts, optn, outfile);
 }
 
 static bool __attribute__((__const__))
@@ -283,10 +788,14 @@ fits_in_bits(long long unsigned n, size_t const nbits, bool const issigned)
 	return (arg.u & mask) == arg.u;
 }
 
-static bool bigendian;
 static bool __attribute__((__const__))
-init_bigendian(void)
+is_bigendian(void)
 {
+#if defined __BYTE_ORDER__ && defined __ORDER_BIG_ENDIAN__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return true;
+#elif defined __BYTE_ORDER__ && defined __ORDER_LITTLE_ENDIAN__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return false;
+#endif
 	union {unsigned char c[2]; unsigned short s;} feff = {{ 0xfe, 0xff }};
 	switch (feff.s) {
 	case 0xfeff:	return true;
@@ -298,21 +807,25 @@ init_bigendian(void)
 static void
 copy_word(void *restrict dest, size_t const destz, void const *restrict src, size_t srcz)
 {
-	memcpy(dest, bigendian ? (char const*)src + srcz - destz : src, destz);
+	memcpy(dest, is_bigendian() ? (char const*)src + srcz - destz : src, destz);
 }
 
 static union dryoptarg
 get_target(struct dryopt const *const opt)
 {
 	union dryoptarg target = {0};
-	copy_word(&target, sizeof target, opt->argptr, opt->sizeof_arg);
+	// widening, unlike copy_word(), so only sizeof_arg bytes to read
+	memcpy((char*)&target.u + (is_bigendian() ? sizeof target.u - opt->sizeof_arg : 0),
+		opt->argptr, opt->sizeof_arg);
 	return target;
 }
 
-static void
-write_optarg(struct dryopt const *restrict const opt, union dryoptarg arg)
+static bool
+write_optarg(struct dryopt_ctx *restrict const ctx,
+		struct dryopt const *restrict const opt, union dryoptarg arg)
 /* If calling this without first calling parse_optarg() (such as if
-   opt->takes_arg == NO_ARG), *BEWARE* opt->type == CALLBACK */
+   opt->takes_arg == NO_ARG), *BEWARE* opt->type == CALLBACK. Returns
+   false if arg didn't fit, having said so */
 {
 	assert(opt->sizeof_arg <= sizeof arg);
 
@@ -334,11 +847,10 @@ write_optarg(struct dryopt const *restrict const opt, union dryoptarg arg)
 		if (sizeof arg.i != opt->sizeof_arg) {
 			assert(sizeof arg.i > opt->sizeof_arg);
 			if (!fits_in_bits(arg.u, opt->sizeof_arg * CHAR_BIT, opt->type == SIGNED)) {
-				/* signed output should always make sense here,
-				   since overflow of the long long sign bit is
-				   tested by strtoll(3) earlier */
+				/* only reachable with .assign_val: arguments
+				   are range checked by parse_integer() */
 				ERR("%lld: %s", arg.i, strerror(ERANGE));
-				return;
+				return false;
 			}
 		}
 
@@ -365,96 +877,729 @@ write_optarg(struct dryopt const *restrict const opt, union dryoptarg arg)
 			// TODO: what about subnormal values?
 			if (isfinite(arg.f) && (arg.f > FLT_MAX || arg.f < -FLT_MAX)) {
 				ERR("%g: %s", arg.f, strerror(ERANGE));
-				return;
+				return false;
 			}
 			*(float*)opt->argptr = (float)arg.f;
 		}
 		break;
 
-	case CALLBACK:	return; // should already have been handled
+	case CALLBACK: case RANGES:
+		break; // should already have been handled
 	default:	abort();
 	}
+	return true;
 }
 
-static bool __attribute__((pure))
-str_n_isnegative(char const * str)
-/* since strtoul(3) and friends don't report underflow on unsigned numbers,
-   we must sadly retrace their steps in order to see if a negative number
-   was inappropriately passed. Basically just /^\s*-/ */
+/* write_optarg(), specialised by type, width and .set_arg, for
+   dryopt_compile() to pick once per option so that parsing needn't switch
+   on them. Integers go through fixed-width types, by value, so endianness
+   doesn't come into it */
+typedef bool (*optwriter)(struct dryopt_ctx *, struct dryopt const *, union dryoptarg);
+
+#define INT_WRITER(T, SET, OP)							\
+	static bool								\
+	write_##T##_##SET(struct dryopt_ctx *const ctx_,			\
+			struct dryopt const *const opt, union dryoptarg const arg)	\
+	{									\
+		T v;								\
+		(void)ctx_;							\
+		memcpy(&v, opt->argptr, sizeof v);				\
+		v OP (T)arg.u;							\
+		memcpy(opt->argptr, &v, sizeof v);				\
+		return true;							\
+	}
+#define INT_WRITERS(T)								\
+	INT_WRITER(T, write, =) INT_WRITER(T, and, &=)				\
+	INT_WRITER(T, or, |=) INT_WRITER(T, xor, ^=)				\
+	static optwriter const T##_writers[] = {				\
+		[DRYARG_WRITE] = write_##T##_write, [DRYARG_AND] = write_##T##_and,	\
+		[DRYARG_OR] = write_##T##_or, [DRYARG_XOR] = write_##T##_xor	\
+	};
+
+INT_WRITERS(uint8_t)
+INT_WRITERS(uint16_t)
+INT_WRITERS(uint32_t)
+INT_WRITERS(uint64_t)
+
+static bool
+write_str(struct dryopt_ctx *const ctx_, struct dryopt const *const opt, union dryoptarg const arg)
 {
-	while (isspace(*str))
-		str++;
-	return *str == '-';
+	(void)ctx_;
+	*(void**)opt->argptr = arg.p;
+	return true;
 }
 
-static char *
-parse_optarg(struct dryopt const *restrict const opt, char *restrict optstr,
-		union dryoptarg *restrict const parsed)
-/* returns optstr after the argument was parsed, or NULL if no argument was
-   parsed */
+static bool
+write_char(struct dryopt_ctx *const ctx_, struct dryopt const *const opt, union dryoptarg const arg)
 {
-	bool arg_found = false;
+	(void)ctx_;
+	*(unsigned char*)opt->argptr = (unsigned char)arg.u;
+	return true;
+}
+
+static bool
+write_double(struct dryopt_ctx *const ctx_, struct dryopt const *const opt, union dryoptarg const arg)
+{
+	(void)ctx_;
+	*(double*)opt->argptr = arg.f;
+	return true;
+}
+
+static bool
+write_float(struct dryopt_ctx *const ctx_, struct dryopt const *const opt, union dryoptarg const arg)
+/* parse_floating() range checks for float, and pick_writer() the default */
+{
+	(void)ctx_;
+	*(float*)opt->argptr = (float)arg.f;
+	return true;
+}
+
+static optwriter
+pick_writer(struct dryopt const *const opt)
+/* write_optarg() itself wherever that has anything to check at runtime:
+   defaults out of range, enums with more values than fit, odd widths */
+{
+	bool const has_default = takes_arg(opt) != REQ_ARG;
+	bool const narrow = opt->sizeof_arg < sizeof opt->assign_val.u;	// as fits_in_bits() needs
+	optwriter const * writers = NULL;
+	size_t n;
 
 	switch (opt->type) {
 	case STR:
-		parsed->p = optstr,
-		optstr += strlen(optstr),	// STR consumes the whole rest of the string
-		arg_found = true;
-		break;
+		return write_str;
 	case CHAR:
-		if (*optstr)
-			// cast is to avoid sign extension
-			parsed->u = (unsigned char)*optstr++,
-			arg_found = true;
+		return opt->assign_val.u <= UCHAR_MAX || !has_default ? write_char : write_optarg;
+	case FLOATING:
+		if (opt->sizeof_arg == sizeof(double))
+			return write_double;
+		if (has_default && isfinite(opt->assign_val.f)
+		    && (opt->assign_val.f > FLT_MAX || opt->assign_val.f < -FLT_MAX))
+			return write_optarg;
+		return write_float;
+	case ENUM_ARG:
+		for (n = 0; opt->enum_args[n]; n++);
+		if (n && narrow && !fits_in_bits(n - 1, opt->sizeof_arg * CHAR_BIT, false))
+			return write_optarg;
 		break;
-	case SIGNED: case UNSIGNED: case FLOATING:
-		{
-			char * endptr = NULL;
-			errno = 0;
-			switch (opt->type) {
-			case SIGNED:
-				parsed->i = strtoll(optstr, &endptr, 0);
-				break;
-			case UNSIGNED:
-				parsed->u = strtoull(optstr, &endptr, 0);
-				break;
-			case FLOATING:
-				parsed->f = strtod(optstr, &endptr);
-				break;
-			default:
-				abort();
-			}
-			switch (errno) {
-			case 0: case EINVAL:
-				break;
-			default:
-				ERR("%s: %s", optstr, strerror(errno));
-				return optstr;
-			}
-			arg_found = *optstr && optstr != endptr,
-			optstr = endptr;
-			if (arg_found && opt->type == UNSIGNED && str_n_isnegative(optstr)) {
-				ERR("%s: %s", optstr, strerror(ERANGE));
-				return optstr;
-			}
-			break;
-		}
-	case CALLBACK:
-		{
-			size_t const consumed = opt->callback(opt, optstr);
-			arg_found = !!consumed, optstr += consumed;
-			break;
+	case SIGNED: case UNSIGNED:
+		if (has_default && narrow && !fits_in_bits(opt->assign_val.u, opt->sizeof_arg * CHAR_BIT,
+				opt->type == SIGNED))
+			return write_optarg;
+		break;
+	default:
+		return write_optarg;
+	}
+
+	if (opt->sizeof_arg == sizeof(uint8_t))
+		writers = uint8_t_writers;
+	else if (opt->sizeof_arg == sizeof(uint16_t))
+		writers = uint16_t_writers;
+	else if (opt->sizeof_arg == sizeof(uint32_t))
+		writers = uint32_t_writers;
+	else if (opt->sizeof_arg == sizeof(uint64_t))
+		writers = uint64_t_writers;
+	return writers ? writers[opt->set_arg] : write_optarg;
+}
+
+/* Numbers are parsed here rather than with strto*(3), which depend on the
+   locale, report through errno, and don't know how wide the destination
+   is. The syntax is theirs in the C locale. Each returns 0, EINVAL if there
+   was no number at all, or ERANGE, setting *endptr as strto*(3) do */
+
+static char const *
+skip_space(char const *s)
+{
+	while (*s == ' ' || (*s >= '\t' && *s <= '\r'))
+		s++;
+	return s;
+}
+
+static unsigned __attribute__((__const__))
+digit_val(char const c)
+// 36 for a non-digit in any base. Assumes ASCII-like letters
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 10;
+	return 36;
+}
+
+static int
+parse_integer(char const *const str, char **const endptr, unsigned const nbits,
+		bool const issigned, long long unsigned *const out)
+/* As strtoll(3) or strtoull(3) with base 0, except that the result has to
+   fit in nbits, and unsigned means not negative */
+{
+	long long unsigned const umax = ULLONG_MAX >> (sizeof umax * CHAR_BIT - nbits);
+	long long unsigned max, n = 0;
+	char const * s = skip_space(str);
+	bool const negative = *s == '-';
+	bool overflow = false;
+	unsigned base = 10, d;
+
+	if (*s == '-' || *s == '+')
+		s++;
+	if (*s == '0') {
+		base = 8;
+		if ((s[1] == 'x' || s[1] == 'X') && digit_val(s[2]) < 16)
+			base = 16, s += 2;
+	}
+	if (digit_val(*s) >= base) {
+		*endptr = (char*)str;
+		return EINVAL;
+	}
+
+	// two's complement goes one further in the negative direction
+	max = issigned ? umax / 2 + negative : umax;
+	for (; (d = digit_val(*s)) < base; s++)
+		if (n > (max - d) / base)
+			overflow = true;	// but keep going, to find the end
+		else
+			n = n * base + d;
+
+	*endptr = (char*)s;
+	if (overflow || (negative && !issigned && n))
+		return ERANGE;
+	*out = negative ? -n : n;
+	return 0;
+}
+
+static void
+set_bits(uint64_t *const words, long long unsigned const lo, long long unsigned const hi)
+/* lo to hi inclusive: the words at either end in part, any between whole */
+{
+	size_t const first = lo / 64, last = hi / 64;
+	uint64_t const head = -1ull << lo % 64, tail = -1ull >> (63 - hi % 64);
+
+	if (first == last) {
+		words[first] |= head & tail;
+		return;
+	}
+	words[first] |= head;
+	memset(words + first + 1, 0xff, (last - first - 1) * sizeof *words);
+	words[last] |= tail;
+}
+
+/* What parse_optarg() returns for an argument that was there but wouldn't
+   do, having said so: it's used up, with nothing stored and no trailing
+   junk to complain about */
+static char rejected_arg[] = "";
+
+static char *
+parse_ranges(struct dryopt_ctx *restrict const ctx, struct dryopt const *restrict const opt,
+		char *s, bool const apply)
+/* A list like 0-3,8,10-63, as far as it goes, into opt's bitset if apply,
+   else only checked. Returns where that was, NULL if not even one number,
+   or rejected_arg for a bad range */
+{
+	char *const start = s;
+
+	if (apply && !opt->set_arg)
+		memset(opt->argptr, 0, (opt->nbits + 63) / 64 * sizeof(uint64_t));
+
+	for (;;) {
+		long long unsigned lo, hi;
+		char * end;
+		int err = digit_val(*s) < 10 ? parse_integer(s, &end, 64, false, &lo) : EINVAL;
+
+		if (!err && (hi = lo, *end == '-'))
+			err = digit_val(end[1]) < 10 ? parse_integer(end + 1, &end, 64, false, &hi) : EINVAL;
+		if (err == EINVAL)
+			break;	// so it's trailing junk
+		if (err || hi >= opt->nbits) {
+			ERR("%.*s: %s", (int)(end - s), s, strerror(ERANGE));
+			return rejected_arg;
+		}
+		if (hi < lo) {
+			ERR("%.*s: backwards range", (int)(end - s), s);
+			return rejected_arg;
+		}
+
+		if (apply)
+			set_bits(opt->argptr, lo, hi);
+		s = end;
+		if (*s != ',' || digit_val(s[1]) >= 10)
+			break;
+		s++;
+	}
+
+	return s == start ? NULL : s;
+}
+
+static bool
+match_word(char const **const s, char const *word)
+// case-insensitive; advances *s past word if it matches
+{
+	char const * p = *s;
+	for (; *word; p++, word++)
+		if ((*p | 0x20) != *word)
+			return false;
+	*s = p;
+	return true;
+}
+
+static int
+strtod_c(char const *const s, size_t const len, double *const out)
+/* strtod(3) in the C locale, for the slow cases: s is known to be a number
+   len chars long */
+{
+	char buf[512];
+	char const *const point = localeconv()->decimal_point;
+	char const * num = s;
+
+	if (strcmp(point, ".") != 0) {
+		char * dot;
+		if (len + strlen(point) > sizeof buf)
+			return ERANGE;	// long enough to be silly anyway
+		memcpy(buf, s, len), buf[len] = '\0';
+		if ((dot = strchr(buf, '.'))) {
+			memmove(dot + strlen(point), dot + 1, buf + len - dot);
+			memcpy(dot, point, strlen(point));
+		}
+		num = buf;
+	}
+
+	errno = 0;
+	*out = strtod(num, NULL);
+	return errno == ERANGE ? ERANGE : 0;
+}
+
+static int
+parse_floating(char const *const str, char **const endptr, bool const single,
+		double *const out)
+/* As strtod(3), and the result must fit in a float if single. Plain
+   decimals, which is nearly all of them, go by Clinger's fast path: up to
+   2^53 times or divided by a power of ten up to 10^22, both of which are
+   exact in a double, so one rounding gives the right answer */
+{
+	static double const pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	char const *const start = skip_space(str);
+	char const * s = start;
+	bool const negative = *s == '-';
+	long long unsigned m = 0;
+	unsigned nsig = 0;	// significant digits in m
+	long e = 0;
+	bool many = false, hex = false, digits = false;
+	double f;
+	int err = 0;
+
+	if (*s == '-' || *s == '+')
+		s++;
+
+	if (match_word(&s, "inf")) {
+		match_word(&s, "inity");
+		f = INFINITY;
+		goto done;
+	}
+	if (match_word(&s, "nan")) {
+		char const * p = s;
+		if (*p == '(') {
+			while (digit_val(*++p) < 36 || *p == '_')
+				;
+			if (*p == ')')
+				s = p + 1;
+		}
+		f = NAN;
+		goto done;
+	}
+
+	if (*s == '0' && (s[1] == 'x' || s[1] == 'X')
+	    && (digit_val(s[2]) < 16 || (s[2] == '.' && digit_val(s[3]) < 16)))
+		hex = true, s += 2;
+
+	for (;; s++) {
+		unsigned const d = digit_val(*s);
+		if (d >= (hex ? 16u : 10u))
+			break;
+		digits = true;
+		if (!m && !d)
+			;
+		else if (nsig < 19)
+			m = m * 10 + d, nsig++;
+		else
+			many = true, e++;
+	}
+	if (*s == '.')
+		for (s++;; s++) {
+			unsigned const d = digit_val(*s);
+			if (d >= (hex ? 16u : 10u))
+				break;
+			digits = true;
+			if (nsig < 19) {
+				if (m || d)
+					m = m * 10 + d, nsig++;
+				e--;
+			} else
+				many = true;
+		}
+	if (!digits) {
+		*endptr = (char*)str;
+		return EINVAL;
+	}
+
+	if ((*s | 0x20) == (hex ? 'p' : 'e')) {
+		char const * p = s + 1;
+		bool const eneg = *p == '-';
+		long x = 0;
+		if (*p == '-' || *p == '+')
+			p++;
+		if (digit_val(*p) < 10) {
+			for (; digit_val(*p) < 10; p++)
+				if (x < 100000)
+					x = x * 10 + digit_val(*p);
+			e += eneg ? -x : x;
+			s = p;
+		}
+	}
+
+	if (!m && !hex) {
+		f = 0;
+		goto done;
+	}
+#if FLT_RADIX == 2 && DBL_MANT_DIG == 53 && defined FLT_EVAL_METHOD && FLT_EVAL_METHOD == 0
+	if (!hex && !many && m <= 1llu << 53) {
+		if (e >= 0 && e <= 22) {
+			f = (double)m * pow10[e];
+			goto done;
+		} else if (e < 0 && e >= -22) {
+			f = (double)m / pow10[-e];
+			goto done;
+		} else if (e > 22 && e <= 22 + 15) {
+			// shift some of the exponent into m if it stays exact
+			for (; e > 22 && m <= (1llu << 53) / 10; e--)
+				m *= 10;
+			if (e == 22) {
+				f = (double)m * pow10[22];
+				goto done;
+			}
+		}
+	}
+#else
+	(void)pow10, (void)many;
+#endif
+	err = strtod_c(start, s - start, &f);
+	if (!err && single && fabs(f) > FLT_MAX && isfinite(f))
+		err = ERANGE;
+	*endptr = (char*)s;
+	if (!err)
+		*out = f;
+	return err;
+
+done:	if (single && isfinite(f) && fabs(f) > FLT_MAX)
+		err = ERANGE;
+	*endptr = (char*)s;
+	if (!err)
+		*out = negative ? -f : f;
+	return err;
+}
+
+/* Flat-array trie, for resolving unique prefixes in time depending only on
+   the length of the argument. Each node's children are contiguous in the
+   array, sorted by the byte leading to them */
+struct trie_node {
+	uint32_t child;	/* index of the first child */
+	uint32_t val;	/* 1 + value of the key ending here, or 0 */
+	uint32_t only;	/* 1 + value of all keys here and below if they're
+			   the same, or 0 */
+	unsigned char c, nchild;	/* byte leading here; number of children */
+};
+
+/* The key is pre followed by str. pre is there for the --no- forms of long
+   options */
+struct trie_key {
+	char const * pre, * str;
+	size_t val;
+};
+
+static unsigned char
+trie_key_at(struct trie_key const *const k, size_t const depth)
+{
+	size_t const prelen = strlen(k->pre);
+	return depth < prelen ? k->pre[depth] : k->str[depth - prelen];
+}
+
+static int
+trie_key_cmp(void const *const a_, void const *const b_)
+// ties are broken by .val, so the lowest takes precedence
+{
+	struct trie_key const *const a = a_, *const b = b_;
+	size_t depth;
+	for (depth = 0;; depth++) {
+		unsigned char const ac = trie_key_at(a, depth), bc = trie_key_at(b, depth);
+		if (ac != bc)
+			return ac - bc;
+		if (!ac)
+			return (a->val > b->val) - (a->val < b->val);
+	}
+}
+
+static void
+trie_build(struct trie_node nodes[], uint32_t *const nnodes, uint32_t const self,
+		struct trie_key const keys[], size_t const n, size_t const depth)
+/* nodes[self] is made the node for keys[], which are sorted and all share
+   their first depth bytes */
+{
+	struct trie_node *const node = nodes + self;
+	size_t i = 0, j;
+	uint32_t child;
+
+	node->val = node->only = 0, node->nchild = 0;
+	if (!n)
+		return;
+
+	node->only = keys[0].val + 1;
+	for (j = 1; j < n; j++)
+		if (keys[j].val != keys[0].val)
+			node->only = 0;
+
+	// keys ending here sort first
+	if (!trie_key_at(keys, depth))
+		for (node->val = keys[0].val + 1; i < n && !trie_key_at(keys + i, depth); i++)
+			;
+
+	for (j = i; j < n; j++)
+		if (j == i || trie_key_at(keys + j, depth) != trie_key_at(keys + j - 1, depth))
+			node->nchild++;
+	node->child = *nnodes, *nnodes += node->nchild;
+
+	for (child = node->child; i < n; i = j, child++) {
+		unsigned char const c = trie_key_at(keys + i, depth);
+		for (j = i; j < n && trie_key_at(keys + j, depth) == c; j++)
+			;
+		nodes[child].c = c;
+		trie_build(nodes, nnodes, child, keys + i, j - i, depth + 1);
+	}
+}
+
+static struct trie_node const *
+trie_walk(struct trie_node const nodes[], char const *s, char const *const stop,
+		char const **const end)
+/* Follows s to its node, up to the NUL or any byte in stop, where *end is
+   left. NULL if no key starts with s, with *end where it went wrong */
+{
+	struct trie_node const * node = nodes;
+
+	for (; *s && !strchr(stop, *s); s++) {
+		struct trie_node const *const child = nodes + node->child;
+		unsigned lo = 0, hi = node->nchild;
+		while (lo < hi) {
+			unsigned const mid = lo + (hi - lo) / 2;
+			if (child[mid].c < (unsigned char)*s)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == node->nchild || child[lo].c != (unsigned char)*s) {
+			*end = s;
+			return NULL;
+		}
+		node = child + lo;
+	}
+
+	*end = s;
+	return node;
+}
+
+/* For listing what an ambiguous prefix could have meant */
+struct candidates {
+	char buf[256];
+	size_t len;
+	size_t last;	/* last value added, +1; only distinct ones are listed */
+};
+
+static void
+candidates_add(struct candidates *const c, char const *const pre,
+		char const *const name, size_t const val)
+{
+	int n;
+	if (c->last == val + 1 || c->len >= sizeof c->buf)
+		return;
+	c->last = val + 1;
+	n = snprintf(c->buf + c->len, sizeof c->buf - c->len, "%s%s%s",
+			c->len ? ", " : "", pre, name);
+	if (n < 0 || (size_t)n >= sizeof c->buf - c->len)
+		// truncated
+		strcpy(c->buf + sizeof c->buf - sizeof "...", "..."),
+		c->len = sizeof c->buf;
+	else
+		c->len += n;
+}
+
+/* Everything the parsing functions need to know about the option table.
+   Initialise it by name: anything left out is NULL or 0, meaning none */
+struct optable {
+	struct dryopt const * opts;
+	size_t optn;
+	struct dryopt_phash const * phash;	/* NULL if none */
+	struct shortopt_index const * shorts;
+	struct dryopt_ctx * ctx;
+	struct dryopt const *const * longidx;	/* sorted by .longopt, or NULL */
+	size_t nlong;
+	/* for each of opts[], a trie of its .enum_args, or NULL. NULL if none */
+	struct trie_node const *const * enum_tries;
+	/* long options, with values 2 * opti + negated. NULL if none */
+	struct trie_node const * longtrie;
+	/* for each of opts[], its pick_writer(). NULL for write_optarg() */
+	optwriter const * writers;
+	/* every spelling of every long option by hash, for exact matches
+	   before longtrie. NULL if none */
+	struct long_hash const * longhash;
+	/* where to look for options not in this one, or NULL */
+	struct optable const * next;
+};
+
+static void
+append(struct dryopt_ctx *restrict const ctx, optwriter const write,
+		struct dryopt const *const opt, union dryoptarg const arg)
+/* write arg to the next element of opt's struct dryopt_array, through a
+   copy of opt pointing there */
+{
+	struct dryopt_array *const arr = opt->argptr;
+	struct dryopt elem = *opt;
+
+	if (arr->n >= arr->cap) {
+		char mb[SHORTOPT_MB_MAX + 1];
+		if (opt->longopt)
+			ERR("too many --%s arguments; room for %lu", opt->longopt,
+				(long unsigned)arr->cap);
+		else
+			ERR("too many -%s arguments; room for %lu",
+				shortopt_mb(ctx->config.utf8, opt->shortopt, mb),
+				(long unsigned)arr->cap);
+		return;
+	}
+
+	elem.argptr = (char*)arr->base + arr->n * (opt->type == STR ? sizeof(char*)
+			: opt->type == CHAR ? 1 : opt->sizeof_arg);
+	if (write(ctx, &elem, arg))
+		arr->n++;	// else not written, so not counted
+}
+
+static void
+store(struct optable const *const t, struct dryopt const *const opt, union dryoptarg const arg)
+{
+	optwriter const write = t->writers ? t->writers[opt - t->opts] : write_optarg;
+	if (opt->append)
+		append(t->ctx, write, opt, arg);
+	else
+		write(t->ctx, opt, arg);
+}
+
+static bool
+match_enum(struct optable const *restrict const t, struct dryopt const *restrict const opt,
+		char const *const arg, size_t *const i)
+/* An exact match, or else a unique prefix */
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct trie_node const *const trie = t->enum_tries ? t->enum_tries[opt - t->opts] : NULL;
+	struct candidates c = { .len = 0 };
+	size_t const len = strlen(arg);
+	size_t j;
+
+	if (trie) {
+		char const * end;
+		struct trie_node const *const node = trie_walk(trie, arg, "", &end);
+		STAT_ADD(compared, end - arg);
+		if (!node)
+			return false;
+		if (node->val || node->only) {
+			*i = (node->val ? node->val : node->only) - 1;
+			return true;
+		}
+	} else {
+		size_t n = 0;
+		for (j = 0; opt->enum_args[j]; j++)
+			if (strncmp(arg, opt->enum_args[j], len) == 0) {
+				if (!opt->enum_args[j][len]) {
+					STAT_ADD(compared, j + 1);
+					*i = j;
+					return true;
+				}
+				*i = j, n++;
+			}
+		STAT_ADD(compared, j);
+		if (n <= 1)
+			return n;
+	}
+
+	// ambiguous, so list the candidates (in table order, either way)
+	for (j = 0; opt->enum_args[j]; j++)
+		if (strncmp(arg, opt->enum_args[j], len) == 0)
+			candidates_add(&c, "", opt->enum_args[j], j);
+	ERR("ambiguous argument `%s' could be: %s", arg, c.buf);
+	return false;
+}
+
+static char *
+parse_optarg(struct optable const *restrict const t,
+		struct dryopt const *restrict const opt, char *restrict optstr,
+		union dryoptarg *restrict const parsed)
+/* returns optstr after the argument was parsed, NULL if no argument was
+   parsed, or rejected_arg */
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	bool arg_found = false;
+
+	switch (opt->type) {
+	case STR:
+		parsed->p = optstr,
+		optstr += strlen(optstr),	// STR consumes the whole rest of the string
+		arg_found = true;
+		break;
+	case CHAR:
+		if (*optstr)
+			// cast is to avoid sign extension
+			parsed->u = (unsigned char)*optstr++,
+			arg_found = true;
+		break;
+	case SIGNED: case UNSIGNED: case FLOATING:
+		{
+			char * endptr;
+			STAT_ADD(conversions, 1);
+			int const err = opt->type == FLOATING
+				? parse_floating(optstr, &endptr,
+					opt->sizeof_arg == sizeof(float), &parsed->f)
+				: parse_integer(optstr, &endptr, opt->sizeof_arg * CHAR_BIT,
+					opt->type == SIGNED, &parsed->u);
+			if (err == ERANGE) {
+				ERR("%.*s: %s", (int)(endptr - optstr), optstr, strerror(ERANGE));
+				return rejected_arg;
+			}
+			arg_found = !err,
+			optstr = endptr;
+			break;
+		}
+	case CALLBACK:
+		{
+			size_t const consumed = opt->callback(opt, optstr);
+			arg_found = !!consumed, optstr += consumed;
+			break;
+		}
+	case RANGES:
+		{
+			// checked first, so that a bad list leaves the set alone
+			char * end;
+			STAT_ADD(conversions, 1);
+			if ((end = parse_ranges(ctx, opt, optstr, false)) == rejected_arg)
+				return rejected_arg;
+			if (end)
+				parse_ranges(ctx, opt, optstr, true);
+			arg_found = !!end, optstr = end;
+			break;
 		}
 	case ENUM_ARG:
 		{
 			size_t i;
-			for (i = 0; opt->enum_args[i]; i++)
-				if (strcmp(optstr, opt->enum_args[i]) == 0) {
-					parsed->u = i,
-					optstr += strlen(optstr),
-					arg_found = true;
-					break;
-				}
+			if (match_enum(t, opt, optstr, &i))
+				parsed->u = i,
+				optstr += strlen(optstr),
+				arg_found = true;
 			break;
 		}
 	default:
@@ -465,17 +1610,17 @@ parse_optarg(struct dryopt const *restrict const opt, char *restrict optstr,
 }
 
 static bool
-negated_boolean_longopt(char const neg_long_opt[], struct dryopt const *const opt)
+negated_boolean_longopt(struct dryopt_ctx *restrict const ctx, struct dryopt const *const opt)
 {
-	if (!(opt->longopt
-	   && opt->type == UNSIGNED
-	   && !opt->takes_arg
-	   && strcmp(neg_long_opt, opt->longopt) == 0))
+	if (!(opt->type == UNSIGNED && !opt->takes_arg))
 		return false;
 
 	// Regular boolean
 	if (!opt->set_arg && opt->assign_val.u == 1) {
-		memset(opt->argptr, 0, opt->sizeof_arg);
+		if (opt->append)	// --no-verbose --verbose --verbose
+			((struct dryopt_array*)opt->argptr)->n = 0;
+		else
+			memset(opt->argptr, 0, opt->sizeof_arg);
 		return true;
 	}
 
@@ -487,187 +1632,1053 @@ negated_boolean_longopt(char const neg_long_opt[], struct dryopt const *const op
 		   negation), to elude, er, my own overflow testing in
 		   write_optarg(). Drat */
 		tmp.assign_val.u ^= -1ull >> ((sizeof tmp.assign_val.u - tmp.sizeof_arg) * CHAR_BIT);
-		write_optarg(&tmp, tmp.assign_val);
+		write_optarg(ctx, &tmp, tmp.assign_val);
+		return true;
+	}
+
+	return false;
+}
+
+static char *
+rsp_token(struct dryopt_rsp *const r)
+/* Returns the next argument in the response file, NUL-terminated in place,
+   or NULL at the end. Arguments are separated by whitespace, which can be
+   quoted as in sh(1): backslash escapes anything outside single quotes */
+{
+	char *in = r->next + strspn(r->next, " \t\n\v\f\r"), *out = in;
+	char *const start = in;
+	char quote = '\0';
+
+	if (!*in) {
+		r->next = in;
+		return NULL;
+	}
+
+	for (; *in; in++) {
+		if (*in == quote)
+			quote = '\0';
+		else if (quote != '\'' && *in == '\\' && in[1])
+			*out++ = *++in;
+		else if (!quote && (*in == '\'' || *in == '"'))
+			quote = *in;
+		else if (!quote && strchr(" \t\n\v\f\r", *in))
+			break;
+		else
+			*out++ = *in;
+	}
+
+	r->next = *in ? in + 1 : in;
+	*out = '\0';	// out <= in, so this is never past the end
+	return start;
+}
+
+#ifdef HAVE_MMAP
+static int
+map_file(int const fd, char **const map, size_t *const maplen, size_t *const filelen)
+/* Privately and writably, with at least one byte past the end, so that
+   there's always somewhere for the last NUL: anonymous zeroes, with the
+   file mapped over the start. Returns 0 or an errno value */
+{
+	struct stat st;
+	long const pagesz = sysconf(_SC_PAGESIZE);
+
+	if (fstat(fd, &st) != 0)
+		return errno;
+
+	*filelen = st.st_size;
+	*maplen = (*filelen / pagesz + 1) * pagesz;
+	*map = mmap(NULL, *maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (*map == MAP_FAILED)
+		return errno;
+	if (*filelen && mmap(*map, *filelen, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		int const err = errno;
+		munmap(*map, *maplen);
+		return err;
+	}
+	return 0;
+}
+#endif
+
+static bool
+rsp_open(struct dryopt_args *const a, char const *const path)
+/* Returns false if path couldn't be opened, in which case the argument is
+   taken literally, as GCC does */
+{
+#ifdef HAVE_MMAP
+	struct dryopt_ctx *const ctx = a->ctx;
+	struct dryopt_rsp * r;
+	size_t filelen;
+	int fd, err;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return false;
+
+	if (a->nmapped == DRYOPT_RSP_MAX) {
+		ERR("@%s: too many response files", path);
+		close(fd);
 		return true;
 	}
 
+	r = a->rsp + a->nmapped;
+	if ((err = map_file(fd, &r->map, &r->len, &filelen)))
+		ERR("@%s: %s", path, strerror(err));
+	else {
+		r->next = r->map;
+		a->stack[a->depth++] = a->nmapped++;
+	}
+
+	close(fd);
+	return true;
+#else
+	(void)a, (void)path;
 	return false;
+#endif
+}
+
+static char *
+args_peek(struct dryopt_args *const a)
+/* The next argument, without consuming it, or NULL at the end. @files are
+   expanded here */
+{
+	while (!a->have_cur) {
+		char * arg;
+
+		if (a->depth) {
+			if (!(arg = rsp_token(a->rsp + a->stack[a->depth - 1]))) {
+				a->depth--;
+				continue;
+			}
+		} else if (*a->argv)
+			arg = *a->argv++;
+		else if (!a->source || !(arg = a->source(a->source_state)))
+			return NULL;
+
+		if (a->expand && *arg == '@' && rsp_open(a, arg + 1))
+			continue;
+
+		a->cur = arg, a->have_cur = 1;
+	}
+
+	return a->cur;
+}
+
+static void
+args_advance(struct dryopt_args *const a)
+{
+	if (a->ctx->stats)
+		a->ctx->stats->args++;
+	a->have_cur = 0;
+}
+
+static void
+args_init(struct dryopt_args *const a, struct dryopt_ctx *const ctx,
+		char *const argv[], bool const expand)
+// argv[0] is skipped
+{
+	if (!ctx->prognam)
+		ctx->prognam = argv[0];
+
+	a->argv = argv + 1, a->ctx = ctx;
+	a->expand = expand, a->have_cur = 0;
+	a->depth = a->nmapped = 0;
+	a->source = NULL;
+}
+
+static size_t
+args_index(struct dryopt_args const *const a, char *const argv[])
+// Where a has got to in argv, when it wasn't expanding anything
+{
+	return a->argv - argv - a->have_cur;
 }
 
 static struct optarg_handled {
-	/* TODO: how about a system of unsigned x, y; denoting argv[x][y],
-	   where we end up? eg.
-		struct optarg_handled { size_t x: 1, y: SIZE_WIDTH - 1; } */
 	char *restrict new_arg;
-	unsigned argi: 1;
+	char * next_arg;	/* the following argument, if consumed */
 } handle_optarg (
+	struct optable const *restrict const t,
 	struct dryopt const *restrict const opt,
-	char *restrict const arg, char *const rest_argv[]
+	char *restrict const arg, struct dryopt_args *const rest
 ) {
+	struct dryopt_ctx *const ctx = t->ctx;
 	struct optarg_handled ret = {0};
 	union dryoptarg parsed;
-	assert(opt->takes_arg != NO_ARG);
+	assert(takes_arg(opt) != NO_ARG);
 
 	if (arg)
-		ret.new_arg = parse_optarg(opt, arg, &parsed);
-	else if (opt->takes_arg == OPT_ARG) {
+		TIMED(ns_convert, ret.new_arg = parse_optarg(t, opt, arg, &parsed));
+	else if (takes_arg(opt) == OPT_ARG) {
 		// peek at next arg
-		if (is_strictly_defined(opt->type)
-			&& (rest_argv[ret.argi] || opt->type == CALLBACK))
-		{
-			ret.new_arg = parse_optarg(opt, rest_argv[ret.argi], &parsed);
+		char *const next = args_peek(rest);
+		if (is_strictly_defined(opt->type) && (next || opt->type == CALLBACK)) {
+			TIMED(ns_convert, ret.new_arg = parse_optarg(t, opt, next, &parsed));
 			if (ret.new_arg) {
 				if (!*ret.new_arg)
-					ret.argi++;
+					ret.next_arg = next, args_advance(rest);
 				else
 					ret.new_arg = NULL; // it never happened
 			}
 		}
-	} else if ((ret.new_arg = rest_argv[ret.argi++]))
-		ret.new_arg = parse_optarg(opt, ret.new_arg, &parsed);
-	else
+	} else if ((ret.new_arg = ret.next_arg = args_peek(rest))) {
+		args_advance(rest);
+		TIMED(ns_convert, ret.new_arg = parse_optarg(t, opt, ret.new_arg, &parsed));
+	} else
 		return ret;
 
-	if (ret.new_arg) {
-		write_optarg(opt, parsed);
-	} else if (opt->takes_arg == OPT_ARG)
-		write_optarg(opt, opt->assign_val);
+	if (ret.new_arg == rejected_arg)
+		;	// already complained
+	else if (ret.new_arg) {
+		TIMED(ns_write, store(t, opt, parsed));
+	} else if (takes_arg(opt) == OPT_ARG)
+		TIMED(ns_write, store(t, opt, opt->assign_val));
 	// else nothing
 
 	return ret;
 }
 
-#define CHECK_ARGNFOUND(optfmt, opt)				\
-	do if (!oh.new_arg && opts[opti].takes_arg == REQ_ARG)	\
-		ERR("missing %s argument to " optfmt, enum_type2str(opts[opti].type), opt);	\
+#define CHECK_ARGNFOUND(optfmt, opt_)				\
+	do if (!oh.new_arg && takes_arg(opt) == REQ_ARG)	\
+		ERR("missing %s argument to " optfmt, enum_type2str(opt->type), opt_);	\
 	while (0)
-#define CHECK_TRAILING_JUNK(optfmt, opt, og_arg)	\
+#define CHECK_TRAILING_JUNK(optfmt, opt_, og_arg)	\
 	do if (oh.new_arg && *oh.new_arg)		\
 		ERR("trailing junk after %lu bytes of argument to "optfmt": %s",	\
-			(long unsigned)(oh.new_arg - (og_arg)), opt, (og_arg));	\
+			(long unsigned)(oh.new_arg - (og_arg)), opt_, (og_arg));	\
 	while (0)
 
-// Returns n of arguments consumed from argv
-static size_t
-parse_longopt(char *const argv[], struct dryopt opts[], size_t const optn)
+static size_t __attribute__((pure))
+count_longopts(struct dryopt const opts[], size_t optn)
+/* opts[] is sorted with the NULL longopts at the end (see dryopt_cmp()),
+   so binary search for the first of those */
 {
-/*	if (dryopt_config.sorting) { //}
-		bsearch(longopt, opts, optn, sizeof *opts, */
+	size_t lo = 0;
+	while (lo < optn) {
+		size_t const mid = lo + (optn - lo) / 2;
+		if (opts[mid].longopt)
+			lo = mid + 1;
+		else
+			optn = mid;
+	}
+	return lo;
+}
 
-	size_t opti, argi = 0;
-	char	*restrict longopt = argv[argi++],
-		* long_arg = NULL;
+/* Direct lookup for short options: ASCII by index, with anything wider
+   binary searched in a little sorted array. Indices rather than pointers,
+   so the ASCII part is 4 cache lines, not 16 */
+struct shortopt_index {
+	uint16_t ascii[128];	/* 1 + index into opts[], or 0 */
+	struct shortopt_wide {
+		wchar_t wc;
+		struct dryopt const * opt;
+	} * wide;
+	size_t nwide, widecap;
+	bool wide_overflow;	/* didn't fit in ascii[] or wide[], so search opts[] */
+};
+#define SHORTOPTS_WIDE_MAX 16	/* widecap when there's nowhere better */
+
+static struct dryopt const *
+index_shortopts(struct shortopt_index *restrict const idx,
+		struct dryopt const opts[], size_t const optn)
+/* idx->wide and idx->widecap must be set beforehand. Where there are
+   duplicates, the first one wins, as in a linear search; returns the first
+   loser, if any */
+{
+	struct dryopt const * dup = NULL;
+	size_t opti;
 
-	if (*longopt == '-' && *++longopt == '-')
-		longopt++;
+	memset(idx->ascii, 0, sizeof idx->ascii);
+	idx->nwide = 0, idx->wide_overflow = false;
 
-	{
-		// find argument
-		char *const equals = strpbrk(longopt, "=:");
-		if (equals)
-			*equals = '\0',
-			long_arg = equals + 1;
-	}
+	for (opti = 0; opti < optn; opti++) {
+		wchar_t const wc = opts[opti].shortopt;
+		size_t i;
 
-	for (opti = 0; opti < optn; opti++)
-		if (opts[opti].longopt && strcmp(longopt, opts[opti].longopt) == 0)
-			goto found;
+		if (!wc)
+			continue;
 
-	if (!long_arg && strncmp(longopt, "no", 2) == 0) {
-		/* Could be a negated boolean long option */
-		char * neg_long_opt = longopt + 2;
-		if (*neg_long_opt == '-')
-			neg_long_opt++;
+		if ((unsigned long)wc < sizeof idx->ascii / sizeof *idx->ascii) {
+			if (idx->ascii[wc]) {
+				if (!dup)
+					dup = opts + opti;
+			} else if (opti < UINT16_MAX)
+				idx->ascii[wc] = (uint16_t)(opti + 1);
+			else
+				idx->wide_overflow = true;
+			continue;
+		}
 
-		for (opti = 0; opti < optn; opti++)
-			if (negated_boolean_longopt(neg_long_opt, opts + opti))
-				return argi;
+		// insertion sort
+		for (i = idx->nwide; i && idx->wide[i - 1].wc >= wc; i--)
+			;
+		if (i < idx->nwide && idx->wide[i].wc == wc) {
+			if (!dup)
+				dup = opts + opti;
+			continue;
+		}
+		if (idx->nwide == idx->widecap) {
+			idx->wide_overflow = true;
+			continue;
+		}
+		memmove(idx->wide + i + 1, idx->wide + i, (idx->nwide - i) * sizeof *idx->wide);
+		idx->wide[i].wc = wc, idx->wide[i].opt = opts + opti;
+		idx->nwide++;
 	}
 
-	// fallen through from above loop: not found
-	if (strcmp(longopt, "help") == 0) {
-		auto_help(opts, optn, stdout);
-		exit(EXIT_SUCCESS);
+	return dup;
+}
+
+static struct dryopt const *
+find_shortopt(struct optable const *const t, wchar_t const wc)
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct shortopt_index const *const idx = t->shorts;
+	size_t lo = 0, hi = idx->nwide, opti;
+
+	STAT_ADD(compared, 1);
+	if ((unsigned long)wc < sizeof idx->ascii / sizeof *idx->ascii) {
+		if (idx->ascii[wc])
+			return t->opts + idx->ascii[wc] - 1;
+		hi = 0;	// nothing that narrow in wide[]
 	}
-	ERR("unrecognised long option: %s", longopt);
-	return argi;
 
-	// inaccessible except by goto label:
-found:	if (opts[opti].type == ENUM_ARG)
-		opts[opti].takes_arg = REQ_ARG;
+	while (lo < hi) {
+		size_t const mid = lo + (hi - lo) / 2;
+		STAT_ADD(compared, 1);
+		if (idx->wide[mid].wc == wc)
+			return idx->wide[mid].opt;
+		if (idx->wide[mid].wc < wc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (idx->wide_overflow)
+		for (opti = 0; opti < t->optn; opti++) {
+			STAT_ADD(compared, 1);
+			if (t->opts[opti].shortopt == wc)
+				return t->opts + opti;
+		}
+
+	return NULL;
+}
+
+#define FNV_BASIS 2166136261u
+
+static uint32_t __attribute__((pure))
+hash_more(uint32_t h, char const *const key, size_t const len)
+/* dryopt_hash() of whatever h was of, followed by key */
+{
+	size_t i;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)key[i]) * 16777619u;
+	return h;
+}
+
+extern uint32_t __attribute__((pure))
+dryopt_hash(char const *const key, size_t const len)
+// 32-bit FNV-1a
+{
+	return hash_more(FNV_BASIS, key, len);
+}
+
+extern uint32_t __attribute__((pure))
+dryopt_hash_salted(char const *const key, size_t const len, uint32_t const salt)
+// the same from another basis, so different keys collide
+{
+	return hash_more(FNV_BASIS ^ salt, key, len);
+}
+
+extern uint32_t __attribute__((__const__))
+dryopt_rehash(uint32_t h, uint32_t const seed)
+// murmur3's finaliser, to spread each seed across all the bits
+{
+	h ^= seed;
+	h ^= h >> 16, h *= 0x85ebca6bu;
+	h ^= h >> 13, h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static struct dryopt_phash_slot const *
+phash_lookup(struct dryopt_phash const *const ph, char const *const key, size_t const len)
+{
+	struct dryopt_phash_slot const * slot;
+	uint32_t h;
+
+	if (!ph->nslots)
+		return NULL;
+
+	h = dryopt_hash_salted(key, len, ph->salt);
+	slot = ph->slots + dryopt_rehash(h, ph->seeds[dryopt_rehash(h, 0) % ph->nseeds]) % ph->nslots;
+	return slot->len == len && memcmp(slot->key, key, len) == 0 ? slot : NULL;
+}
+
+static struct dryopt const *
+find_longopt(struct optable const *const t, char const *const longopt)
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct dryopt const *const opts = t->opts;
+	size_t const optn = t->optn;
+	size_t opti;
+
+	if (t->longidx) {
+		struct dryopt const *const *const found =
+			bsearch(longopt, t->longidx, t->nlong, sizeof *t->longidx, longidx_cmp);
+		STAT_ADD(compared, bsearch_probes(t->nlong));
+		return found ? *found : NULL;
+	}
+
+	if (ctx->config.sorting) {
+		size_t const nlong = count_longopts(opts, optn);
+		STAT_ADD(compared, bsearch_probes(nlong));
+		return bsearch(longopt, opts, nlong, sizeof *opts, longopt_cmp);
+	}
+
+	for (opti = 0; opti < optn; opti++)
+		if (opts[opti].longopt && strcmp(longopt, opts[opti].longopt) == 0) {
+			STAT_ADD(compared, opti + 1);
+			return opts + opti;
+		}
+
+	STAT_ADD(compared, optn);
+	return NULL;
+}
+
+static struct dryopt const *
+lookup_longopt(struct optable const *restrict const t, char const *const longopt,
+		size_t const len, bool *restrict const negated)
+/* longopt must be NUL-terminated at len. *negated is set if longopt
+   turned out to be --no-<something> */
+{
+	struct dryopt const * opt;
+
+	if (t->phash) {
+		struct dryopt_phash_slot const *const slot = phash_lookup(t->phash, longopt, len);
+		if (t->ctx->stats)
+			t->ctx->stats->compared++;
+		if (!slot)
+			return NULL;
+		*negated = slot->negated;
+		return t->opts + slot->opti;
+	}
+
+	*negated = false;
+	if ((opt = find_longopt(t, longopt)))
+		return opt;
+
+	if (strncmp(longopt, "no", 2) == 0) {
+		/* Could be a negated boolean long option */
+		char const * neg_long_opt = longopt + 2;
+		if (*neg_long_opt == '-')
+			neg_long_opt++;
+
+		*negated = true;
+		return find_longopt(t, neg_long_opt);
+	}
+
+	return NULL;
+}
+
+/* The ways of writing a long option: --name, and --no-name or --noname if
+   it takes no argument, as tried by lookup_longopt() */
+static char const *const longopt_pre[] = { "", "no-", "no" };
+
+static bool __attribute__((pure))
+is_key_prefix(char const *const pre, char const *const name, char const *const s,
+		size_t const len)
+// whether the len bytes at s begin pre followed by name
+{
+	size_t const prelen = strlen(pre);
+	if (len <= prelen)
+		return strncmp(s, pre, len) == 0;
+	return strncmp(s, pre, prelen) == 0 && strncmp(s + prelen, name, len - prelen) == 0;
+}
+
+/* Open addressing over the hashes of every way of writing each long
+   option, all in one dense array: an exact match is usually one or two
+   probes of 8 bytes, where the trie would chase a node per byte, and only
+   the option found is looked at. dryopt_compile() builds it */
+struct long_hash {
+	struct long_slot {
+		uint32_t hash;
+		uint32_t val;	/* 1 + 3 * opti + form (of longopt_pre[]), or 0 */
+	} * slots;
+	uint32_t mask;	/* number of slots, a power of 2, less 1 */
+};
+
+static struct dryopt const *
+hash_longopt(struct optable const *restrict const t, char const *const longopt,
+		size_t const len, bool *restrict const negated)
+/* Exact matches only, each checked, since the slots only have hashes */
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct long_hash const *const lh = t->longhash;
+	uint32_t const h = dryopt_hash(longopt, len);
+	uint32_t i;
+
+	for (i = h & lh->mask; lh->slots[i].val; i = (i + 1) & lh->mask) {
+		struct long_slot const s = lh->slots[i];
+		struct dryopt const * opt;
+		size_t prelen;
+
+		STAT_ADD(compared, 1);
+		if (s.hash != h)
+			continue;
+		opt = t->opts + (s.val - 1) / 3;
+		prelen = strlen(longopt_pre[(s.val - 1) % 3]);
+		if (len >= prelen && is_key_prefix(longopt_pre[(s.val - 1) % 3], opt->longopt, longopt, len)
+		    && !opt->longopt[len - prelen]) {
+			*negated = (s.val - 1) % 3;
+			return opt;
+		}
+	}
+	return NULL;
+}
+
+static bool __attribute__((__const__))
+prefix_may_negate(size_t const len)
+/* Whether a prefix this long can be taken for a --no- form: only once
+   `no' and more has been typed, so --n and --no are never --no-<flag>,
+   which would break when a second option that can be negated came along */
+{
+	return len > sizeof "no" - 1;
+}
+
+static struct dryopt const *
+prefix_longopt(struct optable const *restrict const t, char const *const longopt,
+		size_t const len, bool *restrict const negated, bool *restrict const ambiguous)
+/* Unique prefixes, as getopt_long(3) takes them, for when there's no trie:
+   a linear search, but only after the exact match has failed */
+{
+	struct dryopt const * found = NULL;
+	size_t opti, form;
+
+	if (t->ctx->stats)
+		t->ctx->stats->compared += t->optn;
+	for (opti = 0; opti < t->optn; opti++) {
+		struct dryopt const *const opt = t->opts + opti;
+		if (!opt->longopt)
+			continue;
+		for (form = 0; form < (takes_arg(opt) == NO_ARG && prefix_may_negate(len) ? 3u : 1u); form++)
+			if (is_key_prefix(longopt_pre[form], opt->longopt, longopt, len)) {
+				if (found && (found != opt || *negated != !!form)) {
+					*ambiguous = true;
+					return NULL;
+				}
+				found = opt, *negated = !!form;
+			}
+	}
+
+	return found;
+}
+
+static void
+ambiguous_longopt(struct optable const *const t, char const *const longopt)
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	static char const *const shown_pre[] = { "--", "--no-", "--no" };
+	struct candidates c = { .len = 0 };
+	size_t const len = strlen(longopt);
+	size_t opti, form;
+
+	for (opti = 0; opti < t->optn; opti++) {
+		struct dryopt const *const opt = t->opts + opti;
+		if (!opt->longopt)
+			continue;
+		for (form = 0; form < (takes_arg(opt) == NO_ARG && prefix_may_negate(len) ? 3u : 1u); form++)
+			if (is_key_prefix(longopt_pre[form], opt->longopt, longopt, len))
+				candidates_add(&c, shown_pre[form], opt->longopt, 2 * opti + !!form);
+	}
+
+	ERR("option --%s is ambiguous; possibilities: %s", longopt, c.buf);
+}
 
-	if (opts[opti].takes_arg == NO_ARG)
-		if (long_arg)
+#ifdef SCAN_NEON
+static uint64_t
+neon_mask(uint8x16_t const m)
+/* Like SSE2's movemask, but 4 bits a byte */
+{
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+#endif
+
+static char * __attribute__((no_sanitize_address))
+scan_name(char *const s)
+/* The end of a long option's name: its first `=', `:' or NUL, as
+   strcspn(s, "=:") would find, but 16 bytes at a time with SSE2 or NEON,
+   where strpbrk(3) then strlen(3) went over it twice with no argument. Not
+   the argument after it, which for a STR only glibc's wider strlen(3)
+   does, once. The loads are aligned, so reading past the NUL can't cross
+   into another page, but ASan doesn't know that */
+{
+#if defined SCAN_SSE2 || defined SCAN_NEON
+#  ifdef SCAN_SSE2
+	enum { BITS = 1 };	/* of mask per byte */
+	__m128i const zero = _mm_setzero_si128(), eq = _mm_set1_epi8('='), colon = _mm_set1_epi8(':');
+#  else
+	enum { BITS = 4 };
+	uint8x16_t const zero = vdupq_n_u8(0), eq = vdupq_n_u8('='), colon = vdupq_n_u8(':');
+#  endif
+	unsigned const skip = (uintptr_t)s % 16;
+	char * p = (char*)((uintptr_t)s - skip);
+	uint64_t first = ~0ull << skip * BITS;	/* ignoring what's before s */
+
+	for (;; p += 16, first = ~0ull) {
+#  ifdef SCAN_SSE2
+		__m128i const v = _mm_load_si128((__m128i const*)(void*)p);
+		uint64_t const hit = first & (unsigned)_mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(v, zero),
+			_mm_or_si128(_mm_cmpeq_epi8(v, eq), _mm_cmpeq_epi8(v, colon))));
+#  else
+		uint8x16_t const v = vld1q_u8((uint8_t const*)p);
+		uint64_t const hit = first & neon_mask(vorrq_u8(vceqq_u8(v, zero),
+			vorrq_u8(vceqq_u8(v, eq), vceqq_u8(v, colon))));
+#  endif
+		if (hit)
+			return p + __builtin_ctzll(hit) / BITS;
+	}
+#else
+	return s + strcspn(s, "=:");
+#endif
+}
+
+/* Shell completion (see dryopt.h): answered from the tables as they
+   stand, with nothing prepared, so it's only as slow as one parse */
+
+static struct dryopt const *
+complete_findlong(struct optable const * t, char *const name, size_t const len)
+/* name ends at len, maybe at an `=', and may be any unique prefix, as
+   parsing would take it. Not a --no- form, which takes no argument */
+{
+	char const c = name[len];
+	struct dryopt const * opt = NULL;
+	bool negated = false, ambiguous = false;
+
+	name[len] = '\0';
+	for (; t && !opt && !ambiguous; t = t->next)
+		if (!(opt = lookup_longopt(t, name, len, &negated)) && len)
+			opt = prefix_longopt(t, name, len, &negated, &ambiguous);
+	name[len] = c;
+	return negated ? NULL : opt;
+}
+
+static struct dryopt const *
+complete_shortarg(struct optable const *const t, char const * s)
+/* The option in bundle s (past its `-') that takes the next word as its
+   argument, if any */
+{
+	bool const utf8 = t->ctx->config.utf8;
+	mbstate_t ps = {0};
+
+	while (*s) {
+		struct optable const * ot;
+		struct dryopt const * opt = NULL;
+		wchar_t wc;
+		int const n = utf8 ? utf8_decode(&wc, s) : (int)mbrtowc(&wc, s, MB_CUR_MAX, &ps);
+
+		if (n <= 0)
+			return NULL;
+		s += n;
+		for (ot = t; ot && !opt; ot = ot->next)
+			opt = find_shortopt(ot, wc);
+		if (opt && takes_arg(opt) != NO_ARG)
+			// anything left in the bundle is the argument
+			return *s || takes_arg(opt) != REQ_ARG ? NULL : opt;
+	}
+	return NULL;
+}
+
+static void
+complete_arg(struct dryopt const *const opt, char const *const pre, int const prelen,
+		char const *const word)
+/* Candidates for opt's argument word, each after the prelen bytes at pre
+   (eg. --colour=), which the shell wants back */
+{
+	size_t const len = strlen(word);
+	size_t i;
+
+	if (opt->type == ENUM_ARG) {
+		for (i = 0; opt->enum_args[i]; i++)
+			if (strncmp(word, opt->enum_args[i], len) == 0)
+				printf("%.*s%s\n", prelen, pre, opt->enum_args[i]);
+		return;
+	}
+
+	switch (opt->complete) {
+	case COMPLETE_DEFAULT:
+		if (opt->type != STR && opt->type != CALLBACK)
+			break;
+		/* FALLTHROUGH */
+	case COMPLETE_FILE:
+		printf(":file%.*s\n", prelen, pre);
+		break;
+	case COMPLETE_DIR:
+		printf(":dir%.*s\n", prelen, pre);
+		break;
+	case COMPLETE_NONE:
+		break;
+	}
+}
+
+static void
+complete_longopts(struct optable const *const t, char const *const word, size_t const len)
+/* Every --name in the chain beginning with the len bytes at word (past
+   the dashes), and the --no- forms once there's a --no to go on */
+{
+	struct optable const * ot;
+	bool have_help = false;
+	size_t opti, form;
+
+	for (ot = t; ot; ot = ot->next)
+		for (opti = 0; opti < ot->optn; opti++) {
+			struct dryopt const *const opt = ot->opts + opti;
+			if (!opt->longopt)
+				continue;
+			have_help |= strcmp(opt->longopt, "help") == 0;
+			for (form = 0; form < (opt_is_boolean(opt) && len >= 2 ? 2u : 1u); form++)
+				if (is_key_prefix(longopt_pre[form], opt->longopt, word, len))
+					printf("--%s%s\n", longopt_pre[form], opt->longopt);
+		}
+
+	if (!have_help && strncmp(word, "help", len) == 0)
+		puts("--help");
+}
+
+static void __attribute__((noreturn))
+complete(struct optable const *const t, char const * cword_arg, struct dryopt_args *const rest)
+/* --dryopt-complete CWORD WORD...: reads the words up to the one being
+   completed, and prints what could go there */
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct optable const * ot;
+	struct dryopt const * opt;
+	char * cur = NULL, * prev = NULL, * prev2 = NULL, * w, * end;
+	long long unsigned cword, i;
+	bool dashdash = false;
+
+	rest->expand = false, rest->source = NULL;	// words are just words here
+	if (!cword_arg && (cword_arg = args_peek(rest)))
+		args_advance(rest);
+	if (!cword_arg || parse_integer(cword_arg, &end, 32, false, &cword) || *end) {
+		ERR("--dryopt-complete: not a word number: %s", cword_arg ? cword_arg : "(none)");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i <= cword && (w = args_peek(rest)); i++, args_advance(rest)) {
+		if (i == cword)
+			cur = w;
+		else if (i + 1 == cword)
+			prev = w;
+		else if (i + 2 == cword)
+			prev2 = w;
+		if (i && i < cword && strcmp(w, "--") == 0)
+			dashdash = true;
+	}
+	if (!cur)
+		cur = "";
+
+	if (dashdash)
+		puts(":file");
+	// bash splits --name=value at the `=', into three words
+	else if (strcmp(cur, "=") == 0 && prev && strncmp(prev, "--", 2) == 0) {
+		if ((opt = complete_findlong(t, prev + 2, strlen(prev + 2))))
+			complete_arg(opt, "", 0, "");
+	} else if (prev && strcmp(prev, "=") == 0 && prev2 && strncmp(prev2, "--", 2) == 0) {
+		if ((opt = complete_findlong(t, prev2 + 2, strlen(prev2 + 2))))
+			complete_arg(opt, "", 0, cur);
+	} else if (strncmp(cur, "--", 2) == 0) {
+		char *const eq = strchr(cur + 2, '=');
+		if (!eq)
+			complete_longopts(t, cur + 2, strlen(cur + 2));
+		else if ((opt = complete_findlong(t, cur + 2, eq - (cur + 2))))
+			complete_arg(opt, cur, eq + 1 - cur, eq + 1);
+	} else if (strcmp(cur, "-") == 0) {
+		char mb[SHORTOPT_MB_MAX + 1];
+		for (ot = t; ot; ot = ot->next)
+			for (i = 0; i < ot->optn; i++)
+				if (ot->opts[i].shortopt)
+					printf("-%s\n", shortopt_mb(ctx->config.utf8, ot->opts[i].shortopt, mb));
+		complete_longopts(t, "", 0);
+	} else if (*cur == '-')
+		;	// a bundle: nothing to add but the next letter, which is anyone's guess
+	else if (prev && strncmp(prev, "--", 2) == 0 && prev[2] && !strchr(prev, '=')) {
+		if ((opt = complete_findlong(t, prev + 2, strlen(prev + 2))) && takes_arg(opt) == REQ_ARG)
+			complete_arg(opt, "", 0, cur);
+		else
+			puts(":file");
+	} else if (prev && *prev == '-' && prev[1] && prev[1] != '-'
+	           && (opt = complete_shortarg(t, prev + 1)))
+		complete_arg(opt, "", 0, cur);
+	else
+		puts(":file");	// an operand, as far as anyone can tell
+
+	exit(EXIT_SUCCESS);
+}
+
+static void
+put_ident(char const * s)
+// s as a shell function name would have it
+{
+	for (; *s; s++)
+		putchar((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z')
+			|| (*s >= '0' && *s <= '9') ? *s : '_');
+}
+
+static void __attribute__((noreturn))
+complete_script(struct optable const *const t, char const * shell, struct dryopt_args *const rest)
+/* --dryopt-complete-script SHELL: the glue between SHELL and the above */
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	char const * name = ctx->prognam ? ctx->prognam : "";
+
+	if (strrchr(name, '/'))
+		name = strrchr(name, '/') + 1;
+	if (!shell && (shell = args_peek(rest)))
+		args_advance(rest);
+	if (!shell)
+		shell = "";
+
+	if (strcmp(shell, "bash") == 0) {
+		fputs("_", stdout), put_ident(name), fputs("_dryopt() {\n"
+			"\tlocal IFS=$'\\n' cur=${COMP_WORDS[COMP_CWORD]} line pre\n"
+			"\t[[ $cur == = ]] && cur=\n"
+			"\tCOMPREPLY=()\n"
+			"\tfor line in $(\"$1\" --dryopt-complete \"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null); do\n"
+			"\t\tcase $line in\n"
+			"\t\t:file*) pre=${line#:file}; COMPREPLY+=($(compgen -P \"$pre\" -f -- \"${cur#\"$pre\"}\")) ;;\n"
+			"\t\t:dir*) pre=${line#:dir}; COMPREPLY+=($(compgen -P \"$pre\" -d -- \"${cur#\"$pre\"}\")) ;;\n"
+			"\t\t*) COMPREPLY+=(\"$line\") ;;\n"
+			"\t\tesac\n"
+			"\tdone\n"
+			"}\n"
+			"complete -o filenames -F _", stdout);
+		put_ident(name), printf("_dryopt %s\n", name);
+	} else if (strcmp(shell, "zsh") == 0) {
+		printf("#compdef %s\n_", name), put_ident(name), fputs("_dryopt() {\n"
+			"\tlocal line pre\n"
+			"\tlocal -a reply\n"
+			"\tfor line in \"${(@f)$(\"${words[1]}\" --dryopt-complete $((CURRENT - 1)) \"${words[@]}\" 2>/dev/null)}\"; do\n"
+			"\t\tcase $line in\n"
+			"\t\t(:file*) pre=${line#:file}; [[ -n $pre ]] && compset -P \"${(b)pre}\"; _files ;;\n"
+			"\t\t(:dir*) pre=${line#:dir}; [[ -n $pre ]] && compset -P \"${(b)pre}\"; _files -/ ;;\n"
+			"\t\t(?*) reply+=(\"$line\") ;;\n"
+			"\t\tesac\n"
+			"\tdone\n"
+			"\t(( $#reply )) && compadd -- \"${reply[@]}\"\n"
+			"}\n"
+			"compdef _", stdout);
+		put_ident(name), printf("_dryopt %s\n", name);
+	} else if (strcmp(shell, "fish") == 0) {
+		fputs("function __", stdout), put_ident(name), fputs("_dryopt\n"
+			"\tset -l words (commandline -opc)\n"
+			"\tset -l cur (commandline -ct)\n"
+			"\tfor line in ($words[1] --dryopt-complete (count $words) $words $cur 2>/dev/null)\n"
+			"\t\tswitch $line\n"
+			"\t\tcase ':file*'\n"
+			"\t\t\tset -l pre (string sub -s 6 -- $line)\n"
+			"\t\t\tprintf '%s\\n' $pre(__fish_complete_path (string sub -s (math (string length -- \"$pre\") + 1) -- $cur))\n"
+			"\t\tcase ':dir*'\n"
+			"\t\t\tset -l pre (string sub -s 5 -- $line)\n"
+			"\t\t\tprintf '%s\\n' $pre(__fish_complete_directories (string sub -s (math (string length -- \"$pre\") + 1) -- $cur))\n"
+			"\t\tcase '*'\n"
+			"\t\t\tprintf '%s\\n' $line\n"
+			"\t\tend\n"
+			"\tend\n"
+			"end\n", stdout);
+		printf("complete -c %s -f -a '(__", name), put_ident(name), puts("_dryopt)'");
+	} else {
+		ERR("--dryopt-complete-script: no such shell: %s; try bash, zsh or fish", shell);
+		exit(EXIT_FAILURE);
+	}
+
+	exit(EXIT_SUCCESS);
+}
+
+static bool
+is_builtin_longopt(struct optable const *const t, char const *const name)
+/* --help, and --dryopt-complete* except in a config file: only for when
+   no option has that name exactly, but never taken as a prefix of one.
+   None of them does anything from a config file, where exit(3) could take
+   a daemon down, but `help' still isn't a prefix there either */
+{
+	return strcmp(name, "help") == 0
+		|| (t->shorts && (strcmp(name, "dryopt-complete") == 0
+			|| strcmp(name, "dryopt-complete-script") == 0));
+}
+
+static void
+parse_longopt(char *restrict longopt, struct dryopt_args *const rest,
+		struct optable const *const t)
+{
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct dryopt const * opt = NULL;
+	bool negated = false, ambiguous = false, prefixed = false;
+	char *const arg = longopt, * long_arg = NULL, * sep, sepc = '\0';
+	uint64_t const start = stats_clock(ctx);
+	size_t len;
+
+	if (*longopt == '-' && *++longopt == '-')
+		longopt++;
+
+	// where the name ends and any argument begins, once for all below
+	sep = scan_name(longopt), len = sep - longopt;
+	if (*sep)
+		sepc = *sep, *sep = '\0', long_arg = sep + 1;
+
+	if (t->longhash && (opt = hash_longopt(t, longopt, len, &negated)))
+		;	// no need for the walk
+	else if (t->longtrie && prefix_may_negate(len)) {
+		/* shorter, and the trie's unique completion might be a
+		   negation: only the linear search below leaves those out */
+		char const * end;
+		struct trie_node const *const node = trie_walk(t->longtrie, longopt, "", &end);
+		uint32_t const val = node ? (node->val ? node->val : node->only) : 0;
+
+		STAT_ADD(compared, end - longopt);
+		if (val)
+			opt = t->opts + (val - 1) / 2, negated = (val - 1) % 2,
+			prefixed = !node->val;
+		else
+			ambiguous = node && len;
+	} else if (!(opt = lookup_longopt(t, longopt, len, &negated)) && len)
+		opt = prefix_longopt(t, longopt, len, &negated, &ambiguous), prefixed = true;
+	if (start)
+		ctx->stats->ns_lookup += stats_clock(ctx) - start;
+	if ((prefixed || ambiguous) && is_builtin_longopt(t, longopt))
+		opt = NULL, ambiguous = false;
+
+	if (opt) {
+		bool done = false;
+		if (!negated)
+			goto found;
+		if (!long_arg)
+			TIMED(ns_write, done = negated_boolean_longopt(ctx, opt));
+		if (done) {
+			resolved(ctx, opt, DRYOPT_NEGATED, NULL);
+			goto restore;
+		}
+	} else if (ambiguous) {
+		ambiguous_longopt(t, longopt);
+		goto restore;
+	}
+
+	// fallen through from above: not found
+	if (t->shorts && is_builtin_longopt(t, longopt)) {
+		if (strcmp(longopt, "dryopt-complete") == 0)
+			complete(t, long_arg, rest);
+		if (strcmp(longopt, "dryopt-complete-script") == 0)
+			complete_script(t, long_arg, rest);
+		auto_help_r(ctx, t->opts, t->optn, stdout);
+		exit(EXIT_SUCCESS);
+	}
+	if (t->next) {
+		if (sepc)
+			*sep = sepc;
+		parse_longopt(arg, rest, t->next);
+		return;
+	}
+	ERR("unrecognised long option: %s", longopt);
+	goto restore;
+
+	// inaccessible except by goto label:
+found:	if (takes_arg(opt) == NO_ARG) {
+		if (long_arg) {
 			// TODO: parse yes|no|true|false|[10] as an argument
 			ERR("option --%s does not take an argument", longopt);
-		else if (opts[opti].type == CALLBACK)
-			opts[opti].callback(opts + opti, NULL);
+			goto restore;
+		} else if (opt->type == CALLBACK)
+			opt->callback(opt, NULL);
 		else
-			write_optarg(opts + opti, opts[opti].assign_val);
-	else {
+			TIMED(ns_write, store(t, opt, opt->assign_val));
+		resolved(ctx, opt, DRYOPT_LONG, NULL);
+	} else {
 		struct optarg_handled const oh =
-			handle_optarg(opts + opti, long_arg, argv + argi);
+			handle_optarg(t, opt, long_arg, rest);
+		resolved(ctx, opt, DRYOPT_LONG,
+			oh.new_arg ? (long_arg ? long_arg : oh.next_arg) : NULL);
 		CHECK_ARGNFOUND("--%s", longopt);
-		argi += oh.argi;
-		CHECK_TRAILING_JUNK("--%s", longopt, long_arg);
+		CHECK_TRAILING_JUNK("--%s", longopt, long_arg ? long_arg : oh.next_arg);
 	}
 
-	return argi;
+	/* put the `=' back, so the same argv can be parsed again */
+restore:
+	if (sepc)
+		*sep = sepc;
 }
 
 
-static size_t
-parse_shortopts(char *const argv[], struct dryopt opts[], size_t const optn)
+static void
+parse_shortopts(char *const arg, struct dryopt_args *const rest,
+		struct optable const *const t)
 {
-	size_t argi = 0, opti;
-	char * optstr = argv[argi++];
+	struct dryopt_ctx *const ctx = t->ctx;
+	struct optable const * ot;	/* where opt was found */
+	struct dryopt const * opt;
+	char * optstr = arg;
 	mbstate_t ps = {0};
+	bool shifted = false;	/* ps is not in the initial shift state */
 
 	if (*optstr == '-')
 		optstr++;
 
 	for (;;) {
 		wchar_t wc;
-		int conv_ret = mbrtowc(&wc, optstr, MB_CUR_MAX, &ps);
-		if (conv_ret <= 0) {
-			if (conv_ret < 0)
-				ERR("%s: byte %lu of `%s'",
-					strerror(errno), (long unsigned)(optstr - *argv), *argv);
-			return argi;
+		char mb[SHORTOPT_MB_MAX + 1];	// for diagnostics
+#ifndef __STDC_MB_MIGHT_NEQ_WC__
+		/* Printable ASCII means the same thing in the initial shift
+		   state of any encoding we're likely to meet, so don't bother
+		   mbrtowc(3) with it */
+		if (!shifted && *optstr > ' ' && *optstr < 0x7f)
+			wc = *optstr++;
+		else
+#endif
+		{
+			int const conv_ret = ctx->config.utf8
+				? utf8_decode(&wc, optstr)
+				: (int)mbrtowc(&wc, optstr, MB_CUR_MAX, &ps);
+			if (conv_ret <= 0) {
+				if (conv_ret < 0)
+					ERR("%s: byte %lu of `%s'",
+						strerror(errno), (long unsigned)(optstr - arg), arg);
+				return;
+			}
+			optstr += conv_ret;
+			shifted = !ctx->config.utf8 && !mbsinit(&ps);
 		}
-		optstr += conv_ret;
 
-		for (opti = 0; opti < optn; opti++)
-			if (opts[opti].shortopt == wc)
+		for (ot = t; ot; ot = ot->next) {
+			TIMED(ns_lookup, opt = find_shortopt(ot, wc));
+			if (opt)
 				goto found;
+		}
 
 		// fallen through at end of loop: not found
 		switch (wc) {
 		case L'h': case L'?':
-			auto_help(opts, optn, stdout);
+			auto_help_r(ctx, t->opts, t->optn, stdout);
 			exit(EXIT_SUCCESS);
 		default:
-			ERR("unrecognised option: %lc", wc);
+			ERR("unrecognised option: %s", shortopt_mb(ctx->config.utf8, wc, mb));
 			continue;
 		}
 
 		// Now we go back to multibyte processing
-found:		if (opts[opti].type == ENUM_ARG)
-			opts[opti].takes_arg = REQ_ARG;
-
-		if (opts[opti].takes_arg == NO_ARG)
-			if (opts[opti].type == CALLBACK)
-				opts[opti].callback(opts + opti, NULL);
+found:		if (takes_arg(opt) == NO_ARG) {
+			if (opt->type == CALLBACK)
+				opt->callback(opt, NULL);
 			else
-				write_optarg(opts + opti, opts[opti].assign_val);
-		else {
-			struct optarg_handled const oh =
-				handle_optarg(opts + opti, *optstr ? optstr : NULL, argv + argi);
-			CHECK_ARGNFOUND("-%lc", wc);
-			argi += oh.argi;
-			if (oh.argi) {
-				CHECK_TRAILING_JUNK("-%lc", wc, argv[argi - 1]);
-				return argi;
+				TIMED(ns_write, store(ot, opt, opt->assign_val));
+			resolved(ctx, opt, DRYOPT_SHORT, NULL);
+		} else {
+			char *const given = *optstr ? optstr : NULL;
+			struct optarg_handled const oh = handle_optarg(ot, opt, given, rest);
+			resolved(ctx, opt, DRYOPT_SHORT,
+				oh.new_arg ? (given ? given : oh.next_arg) : NULL);
+			CHECK_ARGNFOUND("-%s", shortopt_mb(ctx->config.utf8, wc, mb));
+			if (oh.next_arg) {
+				CHECK_TRAILING_JUNK("-%s", shortopt_mb(ctx->config.utf8, wc, mb),
+					oh.next_arg);
+				return;
 			}
 			if (oh.new_arg)
 				optstr = oh.new_arg;
@@ -675,41 +2686,885 @@ found:		if (opts[opti].type == ENUM_ARG)
 	}
 }
 
+static void
+reverse(char **lo, char **hi)
+{
+	while (lo < --hi) {
+		char *const tmp = *lo;
+		*lo++ = *hi, *hi = tmp;
+	}
+}
+
+static void
+rotate(char **const lo, char **const mid, char **const hi)
+// [mid, hi) to before [lo, mid), each keeping its order
+{
+	if (lo != mid && mid != hi)
+		reverse(lo, mid), reverse(mid, hi), reverse(lo, hi);
+}
+
+/* For permuting: argv so far is runs of options then operands, [start,
+   split) and [split, the next one's start). Merging two rotates the second
+   one's options in front of the first one's operands. As in a merge sort,
+   one is merged into the one after it unless it's more than twice the
+   size, so each argument is moved at most log2(argc) times, and there are
+   never more runs than bits in a pointer */
+struct perm_run { char ** start, ** split; };
+#define PERM_RUNS_MAX (sizeof(char*) * CHAR_BIT)
+
+static void
+merge_runs(struct perm_run *const runs, size_t *const nruns)
+{
+	struct perm_run *const a = runs + *nruns - 2, *const b = a + 1;
+	rotate(a->split, b->start, b->split);
+	a->split += b->split - b->start;
+	--*nruns;
+}
+
+static void
+parse(struct dryopt_args *const a, struct optable const *const t)
+/* Leaves a at the first operand */
+{
+	bool const permute = t->ctx->config.permute && !a->expand && !a->source;
+	struct perm_run runs[PERM_RUNS_MAX];
+	size_t nruns = 1;
+	char * arg;
+
+	runs[0].start = runs[0].split = (char**)a->argv;
+
+	while ((arg = args_peek(a))) {
+		char **const here = (char**)a->argv - 1;
+		bool islong = false, end = false;
+
+		if (arg[0] != '-' || arg[1] == '\0') {	// `-' is stdin, an operand
+			if (!permute)
+				return;
+			a->have_cur = 0;	// one more for the last run
+			continue;
+		}
+
+		args_advance(a);
+		if (arg[1] == '-' && arg[2] == '\0')	// `--'
+			end = true;
+		else {
+			islong = arg[1] == '-';
+			(islong ? parse_longopt : parse_shortopts)(arg, a, t);
+		}
+
+		if (!permute)
+			;
+		else if (runs[nruns - 1].split == here)	// no operands yet this run
+			runs[nruns - 1].split = (char**)a->argv - a->have_cur;
+		else {
+			// a new run: but first, merge what's too small to keep apart
+			while (nruns > 1 && runs[nruns - 1].start - runs[nruns - 2].start
+					<= 2 * (here - runs[nruns - 1].start))
+				merge_runs(runs, &nruns);
+			runs[nruns].start = here;
+			runs[nruns++].split = (char**)a->argv - a->have_cur;
+		}
+		if (end)
+			break;
+	}
+
+	if (permute) {
+		// all into one, with anything from `--' on after it
+		while (nruns > 1)
+			merge_runs(runs, &nruns);
+		a->argv = runs[0].split, a->have_cur = 0;
+	}
+}
+
 extern size_t
-dryopt_parse(char *const argv[], struct dryopt opts[], size_t const optn)
+dryopt_parse_r(struct dryopt_ctx *restrict const ctx, char *const argv[],
+		struct dryopt opts[], size_t const optn)
+{
+	struct shortopt_wide wide[SHORTOPTS_WIDE_MAX];
+	struct shortopt_index shorts;
+	struct optable const t = { .opts = opts, .optn = optn, .shorts = &shorts, .ctx = ctx };
+	struct dryopt_args a;
+	uint64_t const start = stats_clock(ctx);
+
+	args_init(&a, ctx, argv, false);
+
+	sort_opts(ctx, opts, optn);
+
+	shorts.wide = wide, shorts.widecap = SHORTOPTS_WIDE_MAX;
+	index_shortopts(&shorts, opts, optn);
+	if (start)
+		ctx->stats->ns_setup += stats_clock(ctx) - start;
+	parse(&a, &t);
+	return args_index(&a, argv);
+}
+
+extern void
+dryopt_args_init(struct dryopt_args *const args, struct dryopt_ctx *const ctx,
+		char *const argv[])
+{
+	args_init(args, ctx, argv, true);
+}
+
+extern void
+dryopt_parse_args(struct dryopt_args *const args, struct dryopt opts[], size_t const optn)
+{
+	struct dryopt_ctx *const ctx = args->ctx;
+	struct shortopt_wide wide[SHORTOPTS_WIDE_MAX];
+	struct shortopt_index shorts;
+	struct optable const t = { .opts = opts, .optn = optn, .shorts = &shorts, .ctx = ctx };
+	uint64_t const start = stats_clock(ctx);
+
+	sort_opts(ctx, opts, optn);
+
+	shorts.wide = wide, shorts.widecap = SHORTOPTS_WIDE_MAX;
+	index_shortopts(&shorts, opts, optn);
+	if (start)
+		ctx->stats->ns_setup += stats_clock(ctx) - start;
+	parse(args, &t);
+}
+
+extern void
+dryopt_args_source(struct dryopt_args *const args, dryopt_source const source,
+		void *const state)
+{
+	args->source = source, args->source_state = state;
+}
+
+extern char *
+dryopt_read0(void *const state)
+{
+	struct dryopt_read0 *const r = state;
+	size_t from = r->pos;
+
+	for (;;) {
+		char *const nul = memchr(r->buf + from, '\0', r->end - from);
+		long n;
+
+		if (nul) {
+			char *const arg = r->buf + r->pos;
+			r->prev = r->pos, r->pos = nul + 1 - r->buf;
+			r->limit = r->size;	// the one before prev is done with
+			return arg;
+		}
+		from = r->end;
+
+		if (r->eof && r->pos == r->end)
+			return NULL;
+
+		if (r->end == r->limit) {
+			/* Out of room: move the partial argument to the start,
+			   leaving prev where it is, as the caller may still be
+			   looking at it */
+			size_t const partial = r->end - r->pos;
+			if (!r->pos || partial >= r->prev) {
+				r->err = E2BIG;
+				return NULL;
+			}
+			memmove(r->buf, r->buf + r->pos, partial);
+			r->limit = r->prev;
+			r->pos = 0, r->end = from = partial;
+		}
+
+		if (r->eof) {
+			r->buf[r->end++] = '\0';	// unterminated last argument
+			continue;
+		}
+
+#ifdef _POSIX_VERSION
+		n = read(r->fd, r->buf + r->end, r->limit - r->end);
+#else
+		n = -1, errno = ENOSYS;
+#endif
+		if (n > 0)
+			r->end += n;
+		else if (!n)
+			r->eof = 1;
+		else if (errno != EINTR) {
+			r->err = errno;
+			return NULL;
+		}
+	}
+}
+
+extern char *
+dryopt_args_next(struct dryopt_args *const args)
+{
+	char *const arg = args_peek(args);
+	args_advance(args);
+	return arg;
+}
+
+extern void
+dryopt_args_release(struct dryopt_args *const args)
+{
+#ifdef HAVE_MMAP
+	while (args->nmapped--)
+		munmap(args->rsp[args->nmapped].map, args->rsp[args->nmapped].len);
+#endif
+	args->nmapped = args->depth = 0;
+}
+
+static char *
+conf_line(char **const pos, char *const end, size_t *const len)
+/* The line at *pos, less surrounding whitespace, moving *pos on to the
+   next. NULL at the end */
+{
+	char * line = *pos, * eol, * nul;
+
+	if (line >= end)
+		return NULL;
+	if (!(eol = memchr(line, '\n', end - line)))
+		eol = end;
+	// or where the line was cut off when it was applied, if it was
+	if ((nul = memchr(line, '\0', eol - line)))
+		eol = nul;
+	*pos = eol < end ? eol + 1 : end;
+
+	while (line < eol && (*line == ' ' || *line == '\t'))
+		line++;
+	while (eol > line && (eol[-1] == ' ' || eol[-1] == '\t' || eol[-1] == '\r'))
+		eol--;
+	*len = eol - line;
+	return line;
+}
+
+static size_t
+conf_key(struct optable const *const t, char *const line, size_t linelen)
+/* The index in t->opts of the option on line, or t->optn if none */
+{
+	size_t len = 0;
+	char sep;
+	bool negated, ambiguous = false;
+	struct dryopt const * opt;
+
+	while (len < linelen && line[len] != '=' && line[len] != ':')
+		len++;
+	sep = line[len], line[len] = '\0';
+	if (!(opt = lookup_longopt(t, line, len, &negated)) && len)
+		opt = prefix_longopt(t, line, len, &negated, &ambiguous);
+	line[len] = sep;
+	return opt ? (size_t)(opt - t->opts) : t->optn;
+}
+
+static bool
+in_map(char const *const p, char const *const map, size_t const maplen)
+{
+	return p && (uintptr_t)p - (uintptr_t)map < maplen;
+}
+
+static void
+conf_unpoint(struct dryopt const opts[], size_t const optn, char const *const map,
+		size_t const maplen)
+/* Forget any STR argument still pointing into map, which is going: NULL
+   for one option, out of the array for an appending one */
+{
+	size_t opti, i, n;
+
+	for (opti = 0; opti < optn; opti++) {
+		struct dryopt const *const opt = opts + opti;
+		if (opt->type != STR)
+			continue;
+		if (!opt->append) {
+			char **const p = opt->argptr;
+			if (in_map(*p, map, maplen))
+				*p = NULL;
+			continue;
+		}
+		struct dryopt_array *const arr = opt->argptr;
+		char **const strs = arr->base;
+		for (i = n = 0; i < arr->n; i++)
+			if (!in_map(strs[i], map, maplen))
+				strs[n++] = strs[i];
+		arr->n = n;
+	}
+}
+
+static bool
+conf_accumulates(struct dryopt const *const opt)
+/* Whether applying opt's line again would do more than it did the first
+   time. STR appends don't count, as they've been dropped for the old map */
+{
+	return (opt->append && opt->type != STR) || opt->set_arg == DRYARG_XOR
+		|| opt->type == CALLBACK;
+}
+
+static size_t
+conf_count(char *pos, char *const end, char const *const line, size_t const len)
+// lines the same as line in [pos, end)
+{
+	size_t n = 0, l;
+	char const * other;
+
+	while ((other = conf_line(&pos, end, &l)))
+		n += l == len && memcmp(other, line, len) == 0;
+	return n;
+}
+
+extern long
+dryopt_parse_config(struct dryopt_ctx *restrict const ctx, struct dryopt_conf *const conf,
+		char const *const path, struct dryopt opts[], size_t const optn)
+{
+#ifdef HAVE_MMAP
+	static char *const noargs[] = { NULL, NULL };
+	struct optable const t = { .opts = opts, .optn = optn, .ctx = ctx };
+	uint32_t *const hashes = conf->hashes, *const fresh = conf->hashes + optn;
+	char const *const prognam_ = ctx->prognam;
+	struct dryopt_args none;
+	char * map, * pos, * line, * end;
+	size_t maplen, filelen, len, opti;
+	unsigned long lineno;
+	long applied = 0;
+	int fd, err;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	err = map_file(fd, &map, &maplen, &filelen);
+	close(fd);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	end = map + filelen;
+
+	sort_opts(ctx, opts, optn);
+
+	// Hash each option's lines, all together
+	memset(fresh, 0, optn * sizeof *fresh);
+	for (pos = map; (line = conf_line(&pos, end, &len));) {
+		if (!len || *line == '#' || (opti = conf_key(&t, line, len)) == optn)
+			continue;
+		if (!(fresh[opti] = dryopt_rehash(fresh[opti], dryopt_hash(line, len))))
+			fresh[opti] = 1;	// 0 is for absent
+	}
+
+	/* Apply the ones that changed, and any STR, as those point into the
+	   old map, which is forgotten first, in case the line's gone. Unknown
+	   options are applied too, to complain about them. Of a changed
+	   option that accumulates, only lines the old file didn't have are
+	   applied: with a lines the same in the old file and b in the new,
+	   the last b - a. That's a scan of both files for each such line,
+	   but config files aren't long */
+	if (conf->map)
+		conf_unpoint(opts, optn, conf->map, conf->maplen);
+	for (pos = map, lineno = 1; (line = conf_line(&pos, end, &len)); lineno++) {
+		char where[256];
+
+		if (!len || *line == '#')
+			continue;
+		line[len] = '\0';
+		opti = conf_key(&t, line, len);
+		if (opti < optn && fresh[opti] == hashes[opti] && opts[opti].type != STR)
+			continue;
+		if (opti < optn && conf->map && conf_accumulates(opts + opti)
+				&& conf_count(map, line, line, len)
+				< conf_count(conf->map, conf->map + conf->filelen, line, len))
+			continue;
+
+		if (prognam_)
+			snprintf(where, sizeof where, "%s: %s:%lu", prognam_, path, lineno);
+		else
+			snprintf(where, sizeof where, "%s:%lu", path, lineno);
+		ctx->prognam = where;
+		args_init(&none, ctx, noargs, false);
+		parse_longopt(line, &none, &t);
+		ctx->prognam = prognam_;
+		applied++;
+	}
+
+	memcpy(hashes, fresh, optn * sizeof *hashes);
+	dryopt_conf_release(conf);
+	conf->map = map, conf->maplen = maplen, conf->filelen = filelen;
+	return applied;
+#else
+	(void)ctx, (void)conf, (void)path, (void)opts, (void)optn;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+extern void
+dryopt_conf_release(struct dryopt_conf *const conf)
+{
+#ifdef HAVE_MMAP
+	if (conf->map)
+		munmap(conf->map, conf->maplen);
+#endif
+	conf->map = NULL;
+}
+
+static int
+cmd_cmp(void const *const name, void const *const cmd)
+{
+	return strcmp(name, ((struct dryopt_cmd const*)cmd)->name);
+}
+
+static void
+prepare(struct dryopt_ctx *const ctx, struct dryopt opts[], size_t const optn,
+		struct shortopt_index *const shorts, struct shortopt_wide wide[])
+{
+	sort_opts(ctx, opts, optn);
+	shorts->wide = wide, shorts->widecap = SHORTOPTS_WIDE_MAX;
+	index_shortopts(shorts, opts, optn);
+}
+
+extern size_t
+dryopt_dispatch(struct dryopt_ctx *restrict const ctx, char *const argv[],
+		struct dryopt global[], size_t const nglobal,
+		struct dryopt_cmd const cmds[], size_t const ncmds, size_t *const argi)
+{
+	struct shortopt_wide gwide[SHORTOPTS_WIDE_MAX], cwide[SHORTOPTS_WIDE_MAX];
+	struct shortopt_index gshorts, cshorts;
+	struct optable const gt = {
+		.opts = global, .optn = nglobal, .shorts = &gshorts, .ctx = ctx
+	};
+	struct optable ct = gt;
+	struct dryopt_cmd const * cmd;
+	struct dryopt_args a;
+	char const * base;
+	size_t start = 0;
+	uint64_t const t0 = stats_clock(ctx);
+
+	prepare(ctx, global, nglobal, &gshorts, gwide);
+	if (t0)
+		ctx->stats->ns_setup += stats_clock(ctx) - t0;
+
+	// busybox-style, by the name it was run as
+	base = strrchr(argv[0], '/');
+	base = base ? base + 1 : argv[0];
+	if (!(cmd = bsearch(base, cmds, ncmds, sizeof *cmds, cmd_cmp))) {
+		// else git-style, by the first operand
+		unsigned const permute = ctx->config.permute;
+		args_init(&a, ctx, argv, false);
+		ctx->config.permute = 0;	// the command is the first operand, wherever
+		parse(&a, &gt);
+		ctx->config.permute = permute;
+		start = args_index(&a, argv);
+		if (!argv[start]) {
+			ERR("%s", "no command given");
+			return ncmds;
+		}
+		if (!(cmd = bsearch(argv[start], cmds, ncmds, sizeof *cmds, cmd_cmp))) {
+			ERR("unknown command: %s", argv[start]);
+			return ncmds;
+		}
+	}
+
+	{
+		uint64_t const t1 = stats_clock(ctx);
+		prepare(ctx, cmd->opts, cmd->optn, &cshorts, cwide);
+		if (t1)
+			ctx->stats->ns_setup += stats_clock(ctx) - t1;
+	}
+	ct.opts = cmd->opts, ct.optn = cmd->optn, ct.shorts = &cshorts, ct.next = &gt;
+
+	args_init(&a, ctx, argv + start, false);
+	parse(&a, &ct);
+	*argi = start + args_index(&a, argv + start);
+	return cmd - cmds;
+}
+
+/* What dryopt_compile() leaves in its buffer, followed by the arrays it
+   points to */
+struct dryopt_compiled {
+	struct dryopt const * opts;
+	size_t optn, nlong;
+	struct dryopt const ** longidx;
+	optwriter * writers;
+	struct long_hash longhash;
+	struct shortopt_index shorts;
+	struct trie_node const ** enum_tries;
+	struct trie_node const * longtrie;
+};
+
+/* Strictest alignment of anything in the buffer, so the caller's buffer
+   doesn't have to be aligned at all */
+union compiled_align { void * p; optwriter f; size_t z; wchar_t wc; uint32_t u; };
+#define COMPILED_ALIGN offsetof(struct { char c; union compiled_align u; }, u)
+
+static struct dryopt_compiled *
+align_compiled(void const *const buf)
+{
+	uintptr_t const addr = (uintptr_t)buf;
+	return (struct dryopt_compiled*)(addr + (COMPILED_ALIGN - addr % COMPILED_ALIGN) % COMPILED_ALIGN);
+}
+
+static bool
+check_opt(struct dryopt_ctx *restrict const ctx, struct dryopt const *restrict const opt)
+{
+	char const * problem = NULL;
+
+	switch (opt->type) {
+	case STR: case CHAR:
+		break;
+	case SIGNED: case UNSIGNED: case ENUM_ARG:
+		if (!opt->sizeof_arg || opt->sizeof_arg > sizeof(long long))
+			problem = "bad .sizeof_arg";
+		break;
+	case FLOATING:
+		if (opt->sizeof_arg != sizeof(float) && opt->sizeof_arg != sizeof(double))
+			problem = "bad .sizeof_arg";
+		break;
+	case CALLBACK:
+		if (!opt->callback)
+			problem = "NULL .callback";
+		break;
+	case RANGES:
+		if (!opt->nbits)
+			problem = "zero .nbits";
+		else if (opt->set_arg != DRYARG_WRITE && opt->set_arg != DRYARG_OR)
+			problem = "bad .set_arg";
+		break;
+	default:
+		problem = "bad .type";
+	}
+
+	if (problem)
+		;
+	else if (opt->takes_arg > REQ_ARG)
+		problem = "bad .takes_arg";
+	else if (opt->type != CALLBACK && !opt->argptr)
+		problem = "NULL .argptr";
+	else if (opt->type == ENUM_ARG && !opt->enum_args)
+		problem = "NULL .enum_args";
+	else if (opt->append && (opt->type == CALLBACK || opt->type == RANGES || opt->set_arg))
+		problem = ".append with CALLBACK, RANGES or .set_arg";
+	else if (!opt->shortopt && !opt->longopt)
+		problem = "neither .shortopt nor .longopt";
+
+	if (problem)
+		ERR("option table: %s for %s%s", problem,
+			opt->longopt ? "--" : "", opt->longopt ? opt->longopt : "entry without longopt");
+	return !problem;
+}
+
+extern size_t
+dryopt_compile(struct dryopt_ctx *restrict const ctx, struct dryopt const opts[],
+		size_t const optn, void *const buf, size_t const bufsize)
+{
+	struct dryopt_compiled * c;
+	struct dryopt const * dup;
+	struct trie_key * keys;
+	struct trie_node * nodes;
+	unsigned form;
+	size_t opti, nlong = 0, nspell = 0, nwide = 0, ntrie_keys = 0, nnodes = 1, nslots = 1, need;
+	bool ok = true;
+
+	for (opti = 0; opti < optn; opti++) {
+		bool const opt_ok = check_opt(ctx, opts + opti);
+		ok &= opt_ok;
+		if (opts[opti].longopt) {
+			size_t const len = strlen(opts[opti].longopt);
+			nlong++, nspell++, ntrie_keys++, nnodes += len;
+			if (takes_arg(opts + opti) == NO_ARG)
+				nspell += 2, ntrie_keys += 2, nnodes += 2 * len + strlen("no-") + strlen("no");
+		}
+		nwide += (unsigned long)opts[opti].shortopt >= sizeof c->shorts.ascii / sizeof *c->shorts.ascii;
+		if (opt_ok && opts[opti].type == ENUM_ARG) {
+			char const *const * e;
+			nnodes++;	// root
+			for (e = opts[opti].enum_args; *e; e++)
+				ntrie_keys++, nnodes += strlen(*e);
+		}
+	}
+	if (!ok)
+		return 0;
+	while (nslots < 2 * nspell)	// at most half full
+		nslots *= 2;
+
+	need = COMPILED_ALIGN - 1 + sizeof *c + nlong * sizeof *c->longidx
+		+ optn * sizeof *c->writers + nwide * sizeof *c->shorts.wide + optn * sizeof *c->enum_tries
+		+ ntrie_keys * sizeof *keys + nnodes * sizeof *nodes + nslots * sizeof *c->longhash.slots;
+	if (!buf || bufsize < need)
+		return need;
+
+	c = align_compiled(buf);
+	c->opts = opts, c->optn = optn, c->nlong = nlong;
+	c->longidx = (struct dryopt const **)(c + 1);
+	c->writers = (optwriter*)(c->longidx + nlong);
+	c->shorts.wide = (struct shortopt_wide*)(c->writers + optn);
+	c->shorts.widecap = nwide;
+	c->enum_tries = (struct trie_node const **)(c->shorts.wide + nwide);
+	keys = (struct trie_key*)(c->enum_tries + optn);
+	nodes = (struct trie_node*)(keys + ntrie_keys);
+	c->longhash.slots = (struct long_slot*)(nodes + nnodes);
+	c->longhash.mask = (uint32_t)(nslots - 1);
+
+	for (opti = 0; opti < optn; opti++)
+		c->writers[opti] = pick_writer(opts + opti);
+
+	for (opti = 0; opti < optn; opti++) {
+		uint32_t n = 1;
+		size_t nkeys;
+		if (opts[opti].type != ENUM_ARG) {
+			c->enum_tries[opti] = NULL;
+			continue;
+		}
+		for (nkeys = 0; opts[opti].enum_args[nkeys]; nkeys++)
+			keys[nkeys].pre = "",
+			keys[nkeys].str = opts[opti].enum_args[nkeys],
+			keys[nkeys].val = nkeys;
+		qsort(keys, nkeys, sizeof *keys, trie_key_cmp);
+		trie_build(nodes, &n, 0, keys, nkeys, 0);
+		c->enum_tries[opti] = nodes;
+		keys += nkeys, nodes += n;
+	}
+
+	{
+		uint32_t n = 1;
+		size_t nkeys = 0;
+		for (opti = 0; opti < optn; opti++)
+			if (opts[opti].longopt)
+				for (form = 0; form < (takes_arg(opts + opti) == NO_ARG ? 3u : 1u); form++)
+					keys[nkeys].pre = longopt_pre[form],
+					keys[nkeys].str = opts[opti].longopt,
+					keys[nkeys++].val = 2 * opti + !!form;
+		qsort(keys, nkeys, sizeof *keys, trie_key_cmp);
+		trie_build(nodes, &n, 0, keys, nkeys, 0);
+		c->longtrie = nodes;
+	}
+
+	/* each form in turn, so that an exact name is found before a
+	   negation spelt the same, as lookup_longopt() would */
+	memset(c->longhash.slots, 0, nslots * sizeof *c->longhash.slots);
+	for (form = 0; form < 3; form++)
+		for (opti = 0; opti < optn; opti++) {
+			uint32_t h, i;
+			if (!opts[opti].longopt || (form && takes_arg(opts + opti) != NO_ARG))
+				continue;
+			h = hash_more(dryopt_hash(longopt_pre[form], strlen(longopt_pre[form])),
+				opts[opti].longopt, strlen(opts[opti].longopt));
+			for (i = h & c->longhash.mask; c->longhash.slots[i].val; i = (i + 1) & c->longhash.mask)
+				;
+			c->longhash.slots[i].hash = h, c->longhash.slots[i].val = (uint32_t)(1 + 3 * opti + form);
+		}
+
+	for (opti = nlong = 0; opti < optn; opti++)
+		if (opts[opti].longopt)
+			c->longidx[nlong++] = opts + opti;
+	qsort(c->longidx, nlong, sizeof *c->longidx, dryopt_ptr_cmp);
+	for (opti = 1; opti < nlong; opti++)
+		if (strcmp(c->longidx[opti - 1]->longopt, c->longidx[opti]->longopt) == 0) {
+			ERR("option table: duplicate long option --%s", c->longidx[opti]->longopt);
+			return 0;
+		}
+
+	if ((dup = index_shortopts(&c->shorts, opts, optn))) {
+		char mb[SHORTOPT_MB_MAX + 1];
+		ERR("option table: duplicate short option -%s",
+			shortopt_mb(ctx->config.utf8, dup->shortopt, mb));
+		return 0;
+	}
+
+	return need;
+}
+
+extern size_t
+dryopt_parse_compiled(struct dryopt_ctx *restrict const ctx, char *const argv[],
+		void const *const compiled)
+{
+	struct dryopt_compiled const *const c = align_compiled(compiled);
+	struct optable const t = {
+		.opts = c->opts, .optn = c->optn, .shorts = &c->shorts, .ctx = ctx,
+		.longidx = c->longidx, .nlong = c->nlong, .enum_tries = c->enum_tries,
+		.longtrie = c->longtrie, .writers = c->writers,
+		.longhash = c->nlong ? &c->longhash : NULL
+	};
+	struct dryopt_args a;
+
+	args_init(&a, ctx, argv, false);
+	parse(&a, &t);
+	return args_index(&a, argv);
+}
+
+static void
+ctx_from_globals(struct dryopt_ctx *const ctx, char *const argv[])
 {
-	size_t argi = 1;
 	if (!prognam)
 		prognam = argv[0];
-	bigendian = init_bigendian();
 
-#if 0
-	if (dryopt_config.sorting == do_sort)
-		qsort(opts, optn, sizeof *opts, dryopt_cmp)
-#endif
+	ctx->config = dryopt_config,
+	ctx->prognam = prognam,
+	ctx->help_args = DRYopt_help_args,
+	ctx->help_extra = DRYopt_help_extra,
+	ctx->help_text = NULL,
+	ctx->stats = DRYopt_stats,
+	ctx->trace = DRYopt_trace,
+	ctx->trace_data = DRYopt_trace_data;
+
+	if (!dryopt_config.no_setlocale && !dryopt_config.utf8)
+		TIMED(ns_setup, setlocale(LC_ALL, ""));
+}
+
+static void
+ctx_to_globals(struct dryopt_ctx const *const ctx)
+// only the fields parsing can change
+{
+	dryopt_config.mistakes_were_made |= ctx->config.mistakes_were_made;
+}
+
+extern size_t
+dryopt_parse(char *const argv[], struct dryopt opts[], size_t const optn)
+{
+	struct dryopt_ctx ctx;
+	size_t ret;
 
-	if (!dryopt_config.no_setlocale)
-		setlocale(LC_ALL, "");
+	ctx_from_globals(&ctx, argv);
+	ret = dryopt_parse_r(&ctx, argv, opts, optn);
+	ctx_to_globals(&ctx);
+	return ret;
+}
 
-	while (argv[argi]) {
-		bool islong = false;
+extern size_t
+dryopt_parse_phash(char *const argv[], struct dryopt opts[], size_t const optn,
+		struct dryopt_phash const *const phash)
+{
+	struct dryopt_ctx ctx;
+	struct shortopt_wide wide[SHORTOPTS_WIDE_MAX];
+	struct shortopt_index shorts;
+	struct optable const t = {
+		.opts = opts, .optn = optn, .phash = phash, .shorts = &shorts, .ctx = &ctx
+	};
+	struct dryopt_args a;
+
+	uint64_t start;
+
+	ctx_from_globals(&ctx, argv);
+	ctx.help_text = phash->help_text;
+	args_init(&a, &ctx, argv, false);
+	start = stats_clock(&ctx);
+	shorts.wide = wide, shorts.widecap = SHORTOPTS_WIDE_MAX;
+	index_shortopts(&shorts, opts, optn);
+	if (start)
+		ctx.stats->ns_setup += stats_clock(&ctx) - start;
+	parse(&a, &t);
+	ctx_to_globals(&ctx);
+	return args_index(&a, argv);
+}
 
-		if (argv[argi][0] != '-')
-			break;
+/* dryopt_parse_operands() gives each thread at least this many, below
+   which starting one costs more than it saves */
+#define OPERANDS_PER_THREAD 65536
+#define OPERAND_THREADS_MAX 64
+
+struct operand_chunk {
+	struct dryopt const * opt;
+	optwriter write;
+	char *const * operands;
+	size_t lo, hi, bad;	/* [lo, hi), and the first bad one, or hi */
+	int err;	/* why it was bad: ERANGE, or EINVAL */
+};
+
+static void *
+convert_operands(void *const chunk)
+/* Possibly on a thread of its own, so no ERR() or stats here */
+{
+	struct operand_chunk *const c = chunk;
+	struct dryopt elem = *c->opt;
+	size_t const size = elem.sizeof_arg;
+	size_t i;
 
-		switch (argv[argi][1]) {
-		case '-':
-			if (argv[argi][2] == '\0')
-				return ++argi;	// `--'
-			// else
-			islong = true;
-			break;
-		case 0:
-			return argi;	// `-', as in stdin
+	c->bad = c->hi;
+	for (i = c->lo; i < c->hi; i++) {
+		union dryoptarg v;
+		char * end;
+		int const err = elem.type == FLOATING
+			? parse_floating(c->operands[i], &end, size == sizeof(float), &v.f)
+			: parse_integer(c->operands[i], &end, size * CHAR_BIT, elem.type == SIGNED, &v.u);
+
+		if (err || *end) {
+			if (c->bad == c->hi)
+				c->bad = i, c->err = err ? err : EINVAL;
+			continue;
 		}
+		elem.argptr = (char*)c->opt->argptr + i * size;
+		c->write(NULL, &elem, v);
+	}
+	return NULL;
+}
 
-		argi += (islong ? parse_longopt : parse_shortopts)(argv + argi, opts, optn);
+extern size_t
+dryopt_parse_operands(struct dryopt_ctx *restrict const ctx, char *const operands[],
+		size_t const n, struct dryopt const *const opt, unsigned nthreads)
+{
+	struct operand_chunk chunks[OPERAND_THREADS_MAX];
+	struct dryopt type = *opt;
+	size_t nchunks = n / OPERANDS_PER_THREAD, j;
+	uint64_t const t0 = stats_clock(ctx);
+
+	switch (opt->type) {
+	case SIGNED: case UNSIGNED:
+		if (opt->sizeof_arg == 1 || opt->sizeof_arg == 2
+		    || opt->sizeof_arg == 4 || opt->sizeof_arg == 8)
+			break;
+		// fallthrough
+	case FLOATING:
+		if (opt->sizeof_arg == sizeof(float) || opt->sizeof_arg == sizeof(double))
+			break;
+		// fallthrough
+	default:
+		ERR("%s", "operands: bad .type or .sizeof_arg");
+		return 0;
+	}
+	// no defaults and nothing to combine with, so never write_optarg()
+	type.takes_arg = REQ_ARG, type.set_arg = DRYARG_WRITE;
+
+#ifdef HAVE_PTHREADS
+#  ifdef _SC_NPROCESSORS_ONLN
+	if (!nthreads) {
+		long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? (unsigned)ncpus : 1;
 	}
+#  endif
+	if (nchunks > nthreads)
+		nchunks = nthreads;
+	if (nchunks > OPERAND_THREADS_MAX)
+		nchunks = OPERAND_THREADS_MAX;
+#else
+	(void)nthreads;
+	nchunks = 1;
+#endif
+	if (!nchunks)
+		nchunks = 1;
+
+	for (j = 0; j < nchunks; j++) {
+		struct operand_chunk *const c = chunks + j;
+		c->opt = &type, c->write = pick_writer(&type), c->operands = operands,
+		c->lo = n / nchunks * j + (j < n % nchunks ? j : n % nchunks),
+		c->hi = c->lo + n / nchunks + (j < n % nchunks);
+	}
+
+#ifdef HAVE_PTHREADS
+	{
+		pthread_t threads[OPERAND_THREADS_MAX];
+		bool started[OPERAND_THREADS_MAX] = {0};
+		// this thread does the first chunk, or any whose thread wouldn't start
+		for (j = 1; j < nchunks; j++)
+			started[j] = !pthread_create(threads + j, NULL, convert_operands, chunks + j);
+		convert_operands(chunks);
+		for (j = 1; j < nchunks; j++)
+			if (started[j])
+				pthread_join(threads[j], NULL);
+			else
+				convert_operands(chunks + j);
+	}
+#else
+	convert_operands(chunks);
+#endif
+
+	STAT_ADD(conversions, n);
+	if (t0)
+		ctx->stats->ns_convert += stats_clock(ctx) - t0;
 
-	return argi;
+	for (j = 0; j < nchunks; j++) {
+		struct operand_chunk const *const c = chunks + j;
+		if (c->bad == c->hi)
+			continue;
+		if (c->err == ERANGE)
+			ERR("operand %lu: %s: %s", (long unsigned)c->bad + 1, operands[c->bad],
+				strerror(ERANGE));
+		else
+			ERR("operand %lu: %s: not %s", (long unsigned)c->bad + 1, operands[c->bad],
+				enum_type2str(opt->type));
+		return c->bad;
+	}
+	return n;
 }
@@ -5,6 +5,7 @@
 #define DRYOPT_H
 
 #include <stddef.h>	/* wchar_t, size_t */
+#include <stdint.h>	/* uint32_t */
 #include <stdio.h>	/* FILE* */
 
 struct dryopt;
@@ -27,10 +28,12 @@ struct dryopt {
 		FLOATING,	/* note that this only works for the (typically)
 				   IEEE binary formats, not DFP (C23 _Decimal*) */
 		CALLBACK,
-		ENUM_ARG	/* eg. --colour={auto,always,never} */
-	} type: 4;
+		ENUM_ARG,	/* eg. --colour={auto,always,never} */
+		RANGES		/* eg. --cpus=0-3,8,10-63, into a bitset */
+	} type: 5;	/* not 4: where enum bitfields are signed, RANGES would
+			   read back as -8 */
 
-	/* overwritten with REQ_ARG if .type is ENUM_ARGS */
+	/* overwritten with REQ_ARG if .type is ENUM_ARGS or RANGES */
 	enum { NO_ARG = 0, OPT_ARG, REQ_ARG } takes_arg: 2;
 
 	/* Similar to popt(3) POPT_ARGFLAG_(OR|AND|XOR). No equivalent to
@@ -41,6 +44,17 @@ struct dryopt {
 	   .assign_val (8, 010) */
 	unsigned sizeof_arg: 4;
 
+	/* Repeatable: .argptr is a struct dryopt_array of elements of .type
+	   and .sizeof_arg, and each occurrence is written to the next one
+	   (and so must be DRYARG_WRITE). Past .cap, it's an error, not a
+	   realloc(3). For a boolean, the --no- form empties it */
+	unsigned append: 1;
+
+	/* What to offer for the argument in shell completion (see
+	   --dryopt-complete below), if not .enum_args. By default, files for
+	   STR and CALLBACK, nothing otherwise */
+	enum { COMPLETE_DEFAULT = 0, COMPLETE_FILE, COMPLETE_DIR, COMPLETE_NONE } complete: 3;
+
 	union {
 		void * argptr; /* type pointed to depends on .type */
 		dryopt_callback callback;
@@ -62,12 +76,19 @@ struct dryopt {
 		/* if .type == ENUM_ARG, this is a string vector in order
 		   of enum value, eg. enum { ALWAYS, AUTO, NEVER } should
 		   be { "always", "auto", "never", NULL }. The index of the
-		   matching arg will be written to argptr */
+		   matching arg will be written to argptr. Unambiguous
+		   prefixes match too (--colour=al) */
 		char const *const * enum_args;
+
+		/* if .type == RANGES, the size of the bitset at .argptr, an
+		   array of uint64_t, bit n being (word[n / 64] >> n % 64) & 1.
+		   Each number in the list must be under this. DRYARG_WRITE
+		   clears it first, DRYARG_OR doesn't; AND and XOR won't do */
+		size_t nbits;
 	};
 };
 
-#define DRYARG(ARGPTR)	\
+#define DRYARG_TYPE(ARGPTR)	\
 	.type = _Generic((ARGPTR),			\
 			_Bool*:	UNSIGNED,		\
 			char**:	STR,			\
@@ -87,7 +108,10 @@ struct dryopt {
 	.sizeof_arg = _Generic((ARGPTR),		\
 			char**: 0,			\
 			dryopt_callback: 0,		\
-			default: sizeof *(ARGPTR)),	\
+			default: sizeof *(ARGPTR))
+
+#define DRYARG(ARGPTR)	\
+	DRYARG_TYPE(ARGPTR),	\
 	.argptr = (ARGPTR)	/* frustratingly, I can't get _Generic to
 				   pick .callback here */
 
@@ -99,31 +123,137 @@ struct dryopt {
 	DRYARG(ARGPTR), .takes_arg = TAKES_ARG,	.assign_val = {VAL}	\
 }
 
+/* WORDS must be an array of uint64_t, not a pointer */
+#define DRYOPT_RANGES(SHORT, LONG, HELP, WORDS) {			\
+	.shortopt = (SHORT), .longopt = (LONG), .helpstr = (HELP),	\
+	.type = RANGES, .takes_arg = REQ_ARG, .argptr = (WORDS),	\
+	.nbits = sizeof (WORDS) / sizeof *(WORDS) * 64			\
+}
+
+/* Where a .append option puts its arguments: n of them so far, in
+   base[0] to base[n - 1], with room for cap. Eg.
+
+	char * dirs[64];
+	struct dryopt_array incs = DRYOPT_ARRAY_INIT(dirs);
+	struct dryopt opts[] = {
+		DRYOPT_APPEND(L'I', "include", "add DIR to the path", REQ_ARG, &incs, dirs, 0),
+	};
+*/
+struct dryopt_array {
+	void * base;
+	size_t n, cap;
+};
+#define DRYOPT_ARRAY_INIT(ARRAY) { (ARRAY), 0, sizeof (ARRAY) / sizeof *(ARRAY) }
+
+/* Same caveats as DRYOPT(). ARRAY is what ARR's .base points to, for its
+   type; CALLBACK won't do */
+#define DRYOPT_APPEND(SHORT, LONG, HELP, TAKES_ARG, ARR, ARRAY, VAL) {	\
+	.shortopt = (SHORT), .longopt = (LONG), .helpstr = (HELP),	\
+	DRYARG_TYPE(&(ARRAY)[0]), .append = 1, .argptr = (ARR),		\
+	.takes_arg = TAKES_ARG, .assign_val = {VAL}			\
+}
+
+
+/* Shell completion, answered from the table by any of the parsing
+   functions, which exit after: so parse first, before anything slow.
+
+	PROG --dryopt-complete CWORD WORD...
+
+   prints the candidates for WORD number CWORD (0 being PROG itself; one
+   past the last for a new word), one a line: long options by prefix
+   (--no- forms once `--no' is typed), everything for a lone `-',
+   .enum_args for an argument, or `:file' or `:dir' for the shell to
+   complete those itself. Both `--opt=ARG' and bash's split `--opt = ARG'
+   are understood.
+
+	PROG --dryopt-complete-script {bash,zsh,fish}
 
+   prints the glue for that shell, eg. for ~/.bashrc:
+
+	eval "$(PROG --dryopt-complete-script bash)"
+*/
 extern size_t dryopt_parse(char *const[], struct dryopt[], size_t)
 	__attribute__((__access__(read_write, 2, 3), nonnull));
 
+/* Minimal perfect hash over the long options of a table, including the
+   --no- and --no forms of options taking no argument, as emitted by
+   dryopt-gen. Slot n holds the key that hashes to n:
+
+	h = dryopt_hash_salted(key, len, salt);
+	n = dryopt_rehash(h, seeds[dryopt_rehash(h, 0) % nseeds]) % nslots;
+
+   salt is 0 unless two keys' hashes collided, which with thousands of
+   options they well might, and dryopt-gen tried again */
+struct dryopt_phash {
+	uint32_t const * seeds;
+	struct dryopt_phash_slot {
+		char const * key;
+		size_t len, opti;	/* opti indexes the struct dryopt[] */
+		unsigned negated: 1;
+	} const * slots;
+	uint32_t nseeds, nslots, salt;
+	/* --help for this table, precomputed by dryopt_help_c(), or NULL to
+	   render it at runtime */
+	char const * help_text;
+};
+
+extern uint32_t dryopt_hash(char const *, size_t) __attribute__((pure));
+extern uint32_t dryopt_hash_salted(char const *, size_t, uint32_t salt) __attribute__((pure));
+extern uint32_t dryopt_rehash(uint32_t, uint32_t seed) __attribute__((__const__));
+
+/* Like dryopt_parse(), but long options are looked up in phash. opts[]
+   must be in the order phash was generated for, so dryopt_config.sorting
+   is ignored */
+extern size_t dryopt_parse_phash(char *const[], struct dryopt[], size_t,
+		struct dryopt_phash const *)
+	__attribute__((__access__(read_write, 2, 3), nonnull));
+
 /* Note: this returns! */
 extern void auto_help(struct dryopt opts[], size_t optn, FILE *restrict outfile)
 	__attribute__((cold, leaf));
 
 extern struct dryopt_config_s {
 	/* defaults are zeroes across the board */
-	enum { no_sort = 0, do_sort, already_sorted } sorting: 2; /* TODO */
+
+	/* If not no_sort, long options are looked up with bsearch(3), which
+	   needs opts[] sorted by .longopt, with entries lacking a longopt at
+	   the end. do_sort has dryopt_parse() qsort(3) each table into that
+	   order, unless one pass over it finds it is already, so a table is
+	   only sorted once; already_sorted means the caller has seen to it,
+	   and skips even that pass. Note that this also decides the order of
+	   auto_help() output */
+	enum { no_sort = 0, do_sort, already_sorted } sorting: 2;
 	enum { die = 0, complain, noop } autodie: 2;
 	unsigned no_setlocale: 1;
 
+	/* Take arguments (and write diagnostics and help) as UTF-8 whatever
+	   the locale, decoding them without the libc multibyte functions,
+	   and don't call setlocale(3) either. wchar_t short options are then
+	   taken to be Unicode code points, as with __STDC_ISO_10646__ */
+	unsigned utf8: 1;
+
+	/* Take options after operands too, as GNU getopt(3) does: argv is
+	   permuted in place (despite the const, as with GNU) so that the
+	   operands come after the options, both in their original order,
+	   and the index of the first is returned, so the options can be
+	   parsed again from argv. Anything after `--' is still an operand.
+	   Runs of options are rotated in front of the operands before
+	   them, merged as in a merge sort, so it's linear in the length of
+	   argv, times its log2 at worst, when options and operands keep
+	   alternating. Not for
+	   dryopt_parse_args(), whose arguments aren't all in argv */
+	unsigned permute: 1;
+
 	/* this one is an output field: it starts at 0, and is set to 1 on
 	   error. This is redundant unless autodie != die */
 	unsigned mistakes_were_made: 1;
 
 	/* number of columns to wrap auto_help() output to. Default is 80;
-	   set to 0 to disable wrapping. Ten bits fills out to a 16-bit
-	   word, and allows wrapping up to 1023 (0x3FF) columns, which is
-	   plenty: I get 255 on a 2560x1440 screen with 12.5pt font, but
-	   bigger screens and smaller fonts are available. But does anyone
-	   like to read lines that long? If anything 10 bits is more than
-	   enough */
+	   set to 0 to disable wrapping. Ten bits allows wrapping up to
+	   1023 (0x3FF) columns, which is plenty: I get 255 on a 2560x1440
+	   screen with 12.5pt font, but bigger screens and smaller fonts are
+	   available. But does anyone like to read lines that long? If
+	   anything 10 bits is more than enough */
 	unsigned wrap: 10;
 } dryopt_config;
 
@@ -132,7 +262,261 @@ extern struct dryopt_config_s {
    although dryopt_parse() sets prognam */
 extern char const *restrict prognam, *restrict DRYopt_help_args, *restrict DRYopt_help_extra;
 
+/* Instrumentation, all opt-in: point DRYopt_stats (or ctx->stats) at one
+   of these and parsing adds to it, so zero it first. The times are only
+   taken if timing is set, as each costs a clock read */
+struct dryopt_stats {
+	unsigned long args;	/* arguments consumed (options and theirs) */
+	unsigned long shorts, longs, negated;	/* options matched, by form */
+	unsigned long compared;	/* table entries (or trie nodes) looked at */
+	unsigned long conversions;	/* numeric arguments converted */
+	/* nanoseconds spent on setup (setlocale(3), sorting and indexing),
+	   looking up options, converting arguments and writing them out */
+	unsigned long long ns_setup, ns_lookup, ns_convert, ns_write;
+	unsigned timing: 1;
+};
+
+/* Called with DRYopt_trace_data (or ctx->trace_data) for each option once
+   it has been dealt with. arg is where its argument started, if it had one
+   (so for a bundle like -v5n, "5n"), else NULL */
+enum dryopt_form { DRYOPT_SHORT, DRYOPT_LONG, DRYOPT_NEGATED };
+typedef void (*dryopt_trace)(void * data, struct dryopt const *, enum dryopt_form,
+		char const * arg);
+
+extern struct dryopt_stats * DRYopt_stats;
+extern dryopt_trace DRYopt_trace;
+extern void * DRYopt_trace_data;
+
 /* WARNING! <OPTS> may be evaluated twice! */
 #define DRYOPT_PARSE(ARGV, OPTS) dryopt_parse((ARGV), (OPTS), sizeof(OPTS) / sizeof(struct dryopt))
 
+/* Reentrant interface: everything dryopt_parse() gets from (and gives back
+   to) the globals above lives in here instead, so each thread can have its
+   own. Unlike dryopt_parse(), dryopt_parse_r() never calls setlocale(3)
+   (config.no_setlocale is ignored): unless config.utf8 is set, multibyte
+   options are decoded in the calling thread's locale, so set that up
+   before starting any threads. Nor does it modify opts[] unless
+   config.sorting == do_sort, so one table can be shared between threads
+   as long as it's sorted beforehand. prognam is set from argv[0] if NULL.
+   help_text, if set, is the whole of --help, precomputed by
+   dryopt_help_c(), and printed in place of everything else, so it had
+   better be for the table being parsed */
+struct dryopt_ctx {
+	struct dryopt_config_s config;
+	char const *restrict prognam, *restrict help_args, *restrict help_extra,
+		*restrict help_text;
+	struct dryopt_stats * stats;
+	dryopt_trace trace;
+	void * trace_data;
+};
+
+#define DRYOPT_CTX_INIT { .config = { .wrap = 80 } }
+
+extern size_t dryopt_parse_r(struct dryopt_ctx *, char *const[], struct dryopt[], size_t)
+	__attribute__((__access__(read_write, 3, 4), nonnull));
+
+extern void auto_help_r(struct dryopt_ctx const *, struct dryopt const[], size_t,
+		FILE *restrict)
+	__attribute__((cold, leaf, nonnull));
+
+/* auto_help_r() into buf, like snprintf(3): returns the length of the whole
+   help text, only size - 1 bytes of which are written, then a NUL */
+extern size_t dryopt_help_render(struct dryopt_ctx const *, struct dryopt const[], size_t,
+		char *, size_t)
+	__attribute__((cold, nonnull(1, 2)));
+
+/* For build time (see dryopt-gen's %help): dryopt_help_c() writes C for a
+   static char const IDENT_help_text[] holding all of auto_help_r()'s
+   output, for ctx->help_text or phash->help_text, so --help is one write of
+   static data. dryopt_man_r() writes the same as
+   a roff(7) man page */
+extern void dryopt_help_c(struct dryopt_ctx const *, struct dryopt const[], size_t,
+		char const *ident, FILE *restrict)
+	__attribute__((cold, nonnull));
+extern void dryopt_man_r(struct dryopt_ctx const *, struct dryopt const[], size_t,
+		char const *section, FILE *restrict)
+	__attribute__((cold, nonnull));
+
+#define DRYOPT_PARSE_R(CTX, ARGV, OPTS) \
+	dryopt_parse_r((CTX), (ARGV), (OPTS), sizeof(OPTS) / sizeof(struct dryopt))
+
+/* Multi-call binaries and subcommands: one of cmds[], which must be sorted
+   by .name, is picked by the basename of argv[0], as busybox does, or else
+   by the first operand after any global[] options, as git does. Its options
+   are then parsed along with global[]. The command's own options are looked
+   up first (prefixes and all), and --help shows only those. Only global[] and
+   the chosen command's table are prepared, so startup doesn't grow with
+   the number of commands. Likewise config.sorting == do_sort sorts just
+   those two. Returns the chosen command's index in cmds[], with *argi the
+   index in argv of its first operand; ncmds if there wasn't one, having
+   complained */
+struct dryopt_cmd {
+	char const * name;
+	struct dryopt * opts;
+	size_t optn;
+};
+
+extern size_t dryopt_dispatch(struct dryopt_ctx *, char *const argv[],
+		struct dryopt global[], size_t nglobal,
+		struct dryopt_cmd const cmds[], size_t ncmds, size_t * argi)
+	__attribute__((__access__(read_write, 3, 4), nonnull(1, 2, 5, 7)));
+
+#define DRYOPT_DISPATCH(CTX, ARGV, GLOBAL, CMDS, ARGI)			\
+	dryopt_dispatch((CTX), (ARGV), (GLOBAL), sizeof(GLOBAL) / sizeof(struct dryopt),	\
+		(CMDS), sizeof(CMDS) / sizeof(struct dryopt_cmd), (ARGI))
+
+/* For parsing many argument vectors against one table: dryopt_compile()
+   checks opts[] and builds its lookup indices into buf, which needn't be
+   aligned. Like snprintf(3), it returns the size buf needs to be, and only
+   writes to it if bufsize is at least that much, so call it once with
+   buf == NULL to find out. On a bad table it complains through ctx and
+   returns 0. opts[] itself is left alone, but must stay put, as must buf.
+   dryopt_parse_compiled() is then dryopt_parse_r() minus the setup, and
+   with long options and .enum_args looked up in tries rather than one by
+   one, and exact long options first in a dense hash table, so that the
+   only struct dryopt a lookup touches (with its cold .helpstr) is the one
+   it finds. Either way, long options can be abbreviated to any
+   unambiguous prefix, as with getopt_long(3) */
+extern size_t dryopt_compile(struct dryopt_ctx *, struct dryopt const[], size_t,
+		void *, size_t)
+	__attribute__((__access__(read_only, 2, 3), nonnull(1, 2)));
+
+extern size_t dryopt_parse_compiled(struct dryopt_ctx *, char *const[], void const *)
+	__attribute__((nonnull));
+
+/* Response files: with this interface, an argument @file is replaced by
+   the whitespace-separated arguments in file, which may be quoted as in
+   sh(1) and may themselves include @files. file is mmap(2)ed privately and
+   split in place, so the arguments point into the mapping, and there is
+   no copying or allocation. If file can't be opened, @file is taken
+   literally, as GCC does. As operands can come from files, they're
+   fetched one at a time with dryopt_args_next() instead of by index:
+
+	struct dryopt_args args;
+	dryopt_args_init(&args, &ctx, argv);
+	DRYOPT_PARSE_ARGS(&args, opts);
+	while ((operand = dryopt_args_next(&args)))
+		...
+	dryopt_args_release(&args);
+
+   Operands stay valid until dryopt_args_release(), which unmaps the files.
+   Up to DRYOPT_RSP_MAX files can be read, nested or not */
+#define DRYOPT_RSP_MAX 16
+
+/* Source of arguments after argv, returning NULL at the end */
+typedef char *(*dryopt_source)(void *);
+
+struct dryopt_args {
+	char *const * argv;
+	struct dryopt_ctx * ctx;
+	dryopt_source source;
+	void * source_state;
+	char * cur;	/* peeked at but not consumed, if have_cur */
+	unsigned expand: 1, have_cur: 1;
+	unsigned depth, nmapped;
+	unsigned stack[DRYOPT_RSP_MAX];	/* files being read, as indices to rsp */
+	struct dryopt_rsp {
+		char * map, * next;
+		size_t len;
+	} rsp[DRYOPT_RSP_MAX];
+};
+
+extern void dryopt_args_init(struct dryopt_args *, struct dryopt_ctx *, char *const[])
+	__attribute__((nonnull));
+
+/* Like dryopt_parse_r(), leaving args at the first operand */
+extern void dryopt_parse_args(struct dryopt_args *, struct dryopt[], size_t)
+	__attribute__((__access__(read_write, 2, 3), nonnull));
+
+/* Returns NULL when there are no more */
+extern char * dryopt_args_next(struct dryopt_args *) __attribute__((nonnull));
+
+extern void dryopt_args_release(struct dryopt_args *) __attribute__((nonnull));
+
+#define DRYOPT_PARSE_ARGS(ARGS, OPTS) \
+	dryopt_parse_args((ARGS), (OPTS), sizeof(OPTS) / sizeof(struct dryopt))
+
+/* Streaming: once argv runs out, further arguments are pulled from
+   source(state), after dryopt_args_source() and before dryopt_parse_args().
+   Options are applied as they arrive, and dryopt_args_next() gets each
+   operand as it's needed, so the caller can start work before the producer
+   has finished. An argument from source need only stay valid until the one
+   after next is pulled: beware that STR options keep a pointer to theirs */
+extern void dryopt_args_source(struct dryopt_args *, dryopt_source, void *)
+	__attribute__((nonnull(1, 2)));
+
+/* A dryopt_source for NUL-delimited arguments (as from find -print0) read
+   from fd into a fixed buf, which must have room for three of the longest
+   argument with its NUL. At the end, or if it failed, it returns NULL
+   and err is the errno value, or 0 at EOF:
+
+	static char buf[BUFSIZ];
+	struct dryopt_read0 in = DRYOPT_READ0_INIT(STDIN_FILENO, buf, sizeof buf);
+	dryopt_args_source(&args, dryopt_read0, &in);
+*/
+struct dryopt_read0 {
+	char * buf;
+	size_t size, prev, pos, end, limit;
+	int fd, err;
+	unsigned eof: 1;
+};
+
+#define DRYOPT_READ0_INIT(FD, BUF, SIZE) \
+	{ .buf = (BUF), .size = (SIZE), .limit = (SIZE), .fd = (FD) }
+
+extern char * dryopt_read0(void *) __attribute__((nonnull));
+
+/* Config files, for the same table: one `longopt=value' per line, as on
+   the command line less the `--' (so `flag' and `no-flag' too), with
+   blank lines and #comments ignored. The file is mmap(2)ed privately, and
+   STR options point into it until dryopt_conf_release(). Diagnostics are
+   prefixed with file:line.
+
+   Calling dryopt_parse_config() again with the same conf reloads the file
+   (on SIGHUP, or an inotify(7) event, say), re-applying only the options
+   whose lines have changed: each line is hashed, which is cheap, but
+   only those options are converted and written. hashes is for that, and
+   must have 2 * optn entries, zeroed before the first call. Options that
+   accumulate (DRYOPT_APPEND(), DRYARG_XOR, CALLBACK) get only the lines
+   the old file didn't have, so an unchanged line isn't counted, toggled
+   or called back twice. A line taken out of the file undoes nothing,
+   except that a STR option left pointing into the old file is set to
+   NULL (or dropped from its DRYOPT_APPEND() array); keep a copy of any
+   the program must have. Returns the number of lines applied, or -1 if
+   the file couldn't be read, with errno set */
+struct dryopt_conf {
+	uint32_t * hashes;
+	char * map;
+	size_t maplen, filelen;
+};
+
+#define DRYOPT_CONF_INIT(HASHES) { .hashes = (HASHES) }
+
+extern long dryopt_parse_config(struct dryopt_ctx *, struct dryopt_conf *, char const * path,
+		struct dryopt[], size_t)
+	__attribute__((__access__(read_write, 4, 5), nonnull));
+
+extern void dryopt_conf_release(struct dryopt_conf *) __attribute__((nonnull));
+
+#define DRYOPT_PARSE_CONFIG(CTX, CONF, PATH, OPTS) \
+	dryopt_parse_config((CTX), (CONF), (PATH), (OPTS), sizeof(OPTS) / sizeof(struct dryopt))
+
+/* Typed operands: converts operands[0] to operands[n - 1] (eg. what's left
+   of argv after dryopt_parse_r()) to the SIGNED, UNSIGNED or FLOATING
+   type of opt, into the array of n at opt->argptr, with the same checks
+   as an option's argument. Only .type, .sizeof_arg and .argptr matter,
+   so DRYARG() of the array fills it in.
+
+   With millions of them, it's split between up to nthreads threads (0
+   for one per CPU), where there are POSIX threads and it wasn't built
+   with -DDRYOPT_NO_THREADS. Returns the index of the first one that
+   wouldn't convert, having reported it (as operand index + 1), or n if
+   none; the rest are converted regardless */
+extern size_t dryopt_parse_operands(struct dryopt_ctx *, char *const operands[], size_t n,
+		struct dryopt const * opt, unsigned nthreads)
+	__attribute__((nonnull));
+
+#define DRYOPT_PARSE_OPERANDS(CTX, OPERANDS, N, ARRAY) \
+	dryopt_parse_operands((CTX), (OPERANDS), (N), &(struct dryopt const){ DRYARG(ARRAY) }, 0)
+
 #endif /* DRYOPT_H */
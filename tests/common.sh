@@ -0,0 +1,16 @@
+# Sourced by the tests/test-*.sh that run commands of their own: do_test
+# EXPECTATION COMMAND... runs COMMAND, and fails the test unless its
+# output (stdout and stderr together, whatever its exit status) is exactly
+# EXPECTATION
+
+do_test() {
+	expectation=$1
+	shift
+	echo "+> $*"
+	reality=`"$@" 2>&1` || :
+	if test "$expectation" != "$reality"; then
+		printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+			"$*" "$expectation" "$reality"
+		exit 1
+	fi
+}
@@ -0,0 +1,72 @@
+// Repeatable options into fixed-size arrays, and lists into bitsets
+
+#include "../dryopt.h"
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char * dirs[3];
+static uint32_t nums[4];
+static bool verbose[8];
+static uint64_t cpus[3];
+static struct dryopt_array incs = DRYOPT_ARRAY_INIT(dirs),
+		numa = DRYOPT_ARRAY_INIT(nums),
+		verbosity = DRYOPT_ARRAY_INIT(verbose);
+
+static size_t help_all(struct dryopt const * opt __attribute__((unused)),
+		char const * arg __attribute__((unused))) {
+	puts("all the help there is");
+	return 0;
+}
+
+static struct dryopt opts[] = {
+	DRYOPT_APPEND(L'I', "include", "add DIR to the path", REQ_ARG, &incs, dirs, 0),
+	DRYOPT_APPEND(L'n', "num", "add a number", OPT_ARG, &numa, nums, 7),
+	DRYOPT_APPEND(L'v', "verbose", "say more", NO_ARG, &verbosity, verbose, 1),
+	DRYOPT_RANGES(L'c', "cpus", "run on these", cpus),
+	// --help is a prefix of it, but still the built-in one
+	{ 0, "help-all", "help with everything", CALLBACK, NO_ARG, .callback = help_all }
+};
+
+int main(int argc __attribute__((unused)), char *const argv[]) {
+	size_t i;
+#ifdef COMPILED
+	static char buf[4096];
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	if (getenv("TEST_COMPLAIN"))
+		ctx.config.autodie = complain;
+	if (dryopt_compile(&ctx, opts, sizeof opts / sizeof *opts, buf, sizeof buf) - 1 >= sizeof buf)
+		return 2;
+	dryopt_parse_compiled(&ctx, argv, buf);
+#else
+	if (getenv("TEST_COMPLAIN"))
+		dryopt_config.autodie = complain;
+	// TEST_CONFIG="a b": load config file a, then reload it from b
+	char * conf_paths = getenv("TEST_CONFIG"), * path;
+	uint32_t hashes[2 * sizeof opts / sizeof *opts] = {0};
+	struct dryopt_conf conf = DRYOPT_CONF_INIT(hashes);
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	if (conf_paths)
+		for (path = strtok(conf_paths, " "); path; path = strtok(NULL, " "))
+			fprintf(stderr, "%s: %ld applied\n", path, DRYOPT_PARSE_CONFIG(&ctx, &conf, path, opts));
+	DRYOPT_PARSE(argv, opts);
+#endif
+
+	printf("include:");
+	for (i = 0; i < incs.n; i++)
+		printf(" %s", dirs[i]);
+	printf(", num:");
+	for (i = 0; i < numa.n; i++)
+		printf(" %"PRIu32, nums[i]);
+	printf(", verbosity %zu, cpus", verbosity.n);
+	for (i = 0; i < sizeof cpus / sizeof *cpus; i++)
+		printf(" %016"PRIx64, cpus[i]);
+	putchar('\n');
+#ifndef COMPILED
+	dryopt_conf_release(&conf);
+#endif
+	return 0;
+}
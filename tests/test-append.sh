@@ -0,0 +1,65 @@
+#!/bin/sh
+# tests/test-append: repeatable options, and running out of room for them;
+# and range lists
+set -efu
+exe=./$1
+
+. "${0%/*}/common.sh"
+
+zero=0000000000000000
+do_test "include:, num:, verbosity 0, cpus $zero $zero $zero" $exe
+do_test "include: a b c, num: 1 7 65536, verbosity 3, cpus $zero $zero $zero" \
+	$exe -Ia -vn1 --include b -vn --num=0x10000 -Ic -v
+do_test "include:, num: 7 7, verbosity 1, cpus $zero $zero $zero" $exe -vvnn --no-verbose -v
+do_test "$exe: too many --include arguments; room for 3" $exe -Ia -Ib -Ic -Id
+do_test "$exe: too many --num arguments; room for 4" $exe -nnnnn
+
+do_test "include:, num:, verbosity 0, cpus fffffffffffffd0f 8000000000000001 $zero" \
+	$exe --cpus=0-3,8,10-63,64,127
+do_test "include:, num:, verbosity 0, cpus fffffffffffffffe ffffffffffffffff 7fffffffffffffff" \
+	$exe -c 5 -c1-190
+do_test "include:, num:, verbosity 0, cpus $zero $zero 8000000000000000" $exe -c0xbf
+do_test "$exe: 5-4: backwards range" $exe --cpus=1,5-4
+do_test "$exe: trailing junk after 3 bytes of argument to --cpus: 1,2,x" $exe --cpus=1,2,x
+do_test "$exe: missing RANGES argument to -c" $exe -c
+# carrying on past bad lists, which change nothing
+do_test "$exe: 5-4: backwards range
+$exe: 9-8: backwards range
+include:, num: 2, verbosity 0, cpus 000000000000000e $zero $zero" \
+	env TEST_COMPLAIN=1 $exe --cpus=1-3 -c5-4 --cpus=0,9-8 -n2
+echo "+> $exe -c1,192"
+case `$exe -c1,192 2>&1` in
+"$exe: 192: "*) ;;
+*)
+	echo ">>> $exe -c1,192: bad diagnostic"
+	exit 1
+esac
+
+# --help and --dryopt-complete aren't taken as prefixes of an option
+do_test "all the help there is
+include:, num:, verbosity 0, cpus $zero $zero $zero" $exe --help-a
+echo "+> $exe --help"
+case `$exe --help` in
+"Usage: $exe "*"--help-all"*) ;;
+*)
+	echo ">>> $exe --help: no help"
+	exit 1
+esac
+do_test "--help-all
+--help" $exe --dryopt-complete 1 $exe --he
+
+# reloading a config file applies only the lines that are new, so repeated
+# values aren't appended again, nor callbacks called again
+case $exe in
+*-c) ;;
+*)
+	conf=${TMPDIR:-/tmp}/dryopt-conf.$$
+	trap 'rm -f "$conf.1" "$conf.2"' EXIT
+	printf '%s\n' num=1 num=2 help-all verbose >"$conf.1"
+	printf '%s\n' num=1 num=2 help-all num=3 verbose num=2 >"$conf.2"
+	do_test "$conf.1: 4 applied
+$conf.2: 2 applied
+all the help there is
+include:, num: 1 2 3 2, verbosity 1, cpus $zero $zero $zero" \
+		env TEST_CONFIG="$conf.1 $conf.2" $exe
+esac
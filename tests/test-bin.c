@@ -1,10 +1,10 @@
-// TODO: non-ASCII option characters, wrapped help text lines
-
 #include "../dryopt.h"
 
 #include <inttypes.h>
+#include <locale.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 size_t callback(struct dryopt const * opt __attribute__((unused)), char const * arg) {
@@ -32,16 +32,111 @@ static struct dryopt opts[] = {
 	{ L'e', "enum", "pick one of a predetermined set of arguments",
 		ENUM_ARG, 0, 0, sizeof e, .argptr = &e, .enum_args = enum_args },
 	// It can init a CALLBACK, but not within the strictest of ISO C
-	{ L'c', "callback", "call callback", CALLBACK, OPT_ARG, .callback = callback }
+	{ L'c', "callback", "call callback", CALLBACK, OPT_ARG, .callback = callback },
+#ifdef UTF8
+	// taken as UTF-8 whatever the locale
+	DRYOPT(L'é', NULL, "set flag, but with an é", NO_ARG, &flag, 1),
+	DRYOPT(L'λ', NULL, "set value, but λ", REQ_ARG, &value, 0)
+#endif
 };
 
+// TEST_COMPLAIN: carry on past errors, to see what was (not) stored
+#define SET_AUTODIE(CONFIG) ((CONFIG).autodie = getenv("TEST_COMPLAIN") ? complain : die)
+
+#ifdef REENTRANT
+static void trace(void * data, struct dryopt const * opt, enum dryopt_form form, char const * arg) {
+	static char const *const forms[] = { "short", "long", "negated" };
+	fprintf(data, "%s %s %s\n", forms[form], opt->longopt, arg ? arg : "(none)");
+}
+#endif
+
 int main(int argc __attribute__((unused)), char *const argv[]) {
+#if defined COMPILED
+	static char buf[4096];
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	SET_AUTODIE(ctx.config);
+	size_t i = dryopt_compile(&ctx, opts, sizeof opts / sizeof *opts, buf, sizeof buf);
+	if (!i || i > sizeof buf)
+		return 2;
+	i = dryopt_parse_compiled(&ctx, argv, buf);
+#elif defined RESPONSE_FILES
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	SET_AUTODIE(ctx.config);
+	struct dryopt_args args;
+	char * arg;
+	dryopt_args_init(&args, &ctx, argv);
+#  ifdef STREAM
+	// small, to make it wrap round
+	static char buf[48];
+	struct dryopt_read0 in = DRYOPT_READ0_INIT(0, buf, sizeof buf);
+	dryopt_args_source(&args, dryopt_read0, &in);
+#  endif
+	DRYOPT_PARSE_ARGS(&args, opts);
+#elif defined REENTRANT
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	SET_AUTODIE(ctx.config);
+	struct dryopt_stats stats = { .timing = 1 };
+	if (getenv("TEST_TRACE"))
+		ctx.stats = &stats, ctx.trace = trace, ctx.trace_data = stderr;
+	// TEST_CONFIG="a b": load config file a, then reload it from b
+	char * conf_paths = getenv("TEST_CONFIG"), * path;
+	uint32_t hashes[2 * sizeof opts / sizeof *opts] = {0};
+	struct dryopt_conf conf = DRYOPT_CONF_INIT(hashes);
+	if (conf_paths)
+		for (path = strtok(conf_paths, " "); path; path = strtok(NULL, " "))
+			fprintf(stderr, "%s: %ld applied\n", path, DRYOPT_PARSE_CONFIG(&ctx, &conf, path, opts));
+	size_t i = DRYOPT_PARSE_R(&ctx, argv, opts);
+	if (ctx.stats)
+		fprintf(stderr, "args %lu, short %lu, long %lu, negated %lu, conversions %lu\n",
+			stats.args, stats.shorts, stats.longs, stats.negated, stats.conversions);
+#else
+#  ifdef PERMUTE
+	dryopt_config.permute = 1;
+#  endif
+#  ifdef UTF8
+	dryopt_config.utf8 = 1;
+	// TEST_WRAP: a narrower --help, wrapped by columns, not bytes
+	if (getenv("TEST_WRAP"))
+		dryopt_config.wrap = atoi(getenv("TEST_WRAP"));
+#  endif
+	SET_AUTODIE(dryopt_config);
 	size_t i = DRYOPT_PARSE(argv, opts);
+#  ifdef PERMUTE
+	// TEST_PERMUTED: all of argv as it's been left, to parse again
+	if (getenv("TEST_PERMUTED")) {
+		size_t j;
+		printf("permuted:");
+		for (j = 1; argv[j]; j++)
+			printf("\t%s", argv[j]);
+		putchar('\n');
+	}
+#  endif
+#  ifdef UTF8
+	// TEST_LOCALE: which dryopt_parse() should have left alone
+	if (getenv("TEST_LOCALE"))
+		printf("locale: %s\n", setlocale(LC_CTYPE, NULL));
+#  endif
+#endif
 	printf("-v %"PRId16"	-b %"PRIuMAX"	-s %s	-n %d	-F %g\n"
 		"arguments after options:",
 		value, bigvalue, strarg, flag, fl);
+#ifdef RESPONSE_FILES
+	while ((arg = dryopt_args_next(&args)))
+		printf("\t%s", arg);
+	dryopt_args_release(&args);
+#  ifdef STREAM
+	if (in.err) {
+		printf("\n%s", strerror(in.err));
+		return 1;
+	}
+#  endif
+#else
 	while (argv[i])
 		printf("\t%s", argv[i++]);
+#endif
 	putchar('\n');
+#ifdef REENTRANT
+	dryopt_conf_release(&conf);
+#endif
 	return 0;
 }
@@ -0,0 +1,36 @@
+/* Generated by dryopt-gen from tests/test-collide.dryopt; do not edit */
+
+#include "../dryopt.h"
+
+#include <stdio.h>
+
+static int a, b;
+
+struct dryopt opts[] = {
+	{ .shortopt = 0, .longopt = "nakmvxxv", .helpstr = "same hash as --tbdxatiq",
+	  DRYARG(&a), .takes_arg = REQ_ARG, .assign_val = {0} },
+	{ .shortopt = 0, .longopt = "tbdxatiq", .helpstr = "same hash as --nakmvxxv",
+	  DRYARG(&b), .takes_arg = REQ_ARG, .assign_val = {0} },
+};
+
+static uint32_t const opts_phash_seeds[] = {
+	3
+};
+
+static struct dryopt_phash_slot const opts_phash_slots[] = {
+	{ "tbdxatiq", 8, 1, 0 },
+	{ "nakmvxxv", 8, 0, 0 },
+};
+
+struct dryopt_phash const opts_phash = {
+	opts_phash_seeds, opts_phash_slots, 1, 2, 1, NULL
+};
+
+#define opts_PARSE(ARGV) dryopt_parse_phash((ARGV), opts,	\
+		sizeof opts / sizeof *opts, &opts_phash)
+
+int main(int argc __attribute__((unused)), char *const argv[]) {
+	opts_PARSE(argv);
+	printf("%d %d\n", a, b);
+	return 0;
+}
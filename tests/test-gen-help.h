@@ -0,0 +1,11 @@
+static char const opts_help_text[] =
+	"Usage: test-gen [OPTS] [ARGS]\n"
+	"  -v, --value=SIGNED             set value\n"
+	"  -b, --bigvalue=[UNSIGNED]      set bigvalue\n"
+	"  -s, --strarg=[STR]             set strarg\n"
+	"  -n, --[no-]flag                boolean; takes no argument\n"
+	"  -F, --float=FLOATING           set fl (double)\n"
+	"  -e, --enum=never,auto,always   pick one of a predetermined set of arguments\n"
+	"  -c, --callback=[ARG]           call callback\n"
+	"  -h, -?, --help                 Print this help and exit\n"
+	"";
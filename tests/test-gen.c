@@ -0,0 +1,112 @@
+/* Generated by dryopt-gen from tests/test-gen.dryopt; do not edit */
+
+#include "../dryopt.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t callback(struct dryopt const * opt __attribute__((unused)), char const * arg) {
+	printf("callback saw: %s\n", arg);
+	return arg ? strlen(arg) : 0;
+}
+
+static int16_t value = 0;
+static uintmax_t bigvalue = 1;
+static char * strarg = NULL;
+static bool flag = false;
+static double fl = 0.0;
+static enum { NEVER, AUTO, ALWAYS } e = ALWAYS;
+static char const *const enum_args[] = { "never", "auto", "always", NULL };
+
+struct dryopt opts[] = {
+	{ .shortopt = L'v', .longopt = "value", .helpstr = "set value",
+	  DRYARG(&value), .takes_arg = REQ_ARG, .assign_val = {0} },
+	{ .shortopt = L'b', .longopt = "bigvalue", .helpstr = "set bigvalue",
+	  DRYARG(&bigvalue), .takes_arg = OPT_ARG, .assign_val = {0} },
+	{ .shortopt = L's', .longopt = "strarg", .helpstr = "set strarg",
+	  DRYARG(&strarg), .takes_arg = OPT_ARG, .assign_val = {0} },
+	{ .shortopt = L'n', .longopt = "flag", .helpstr = "boolean; takes no argument",
+	  DRYARG(&flag), .takes_arg = NO_ARG, .assign_val = {1} },
+	{ .shortopt = L'F', .longopt = "float", .helpstr = "set fl (double)",
+	  DRYARG(&fl), .takes_arg = REQ_ARG, .assign_val = {0} },
+	{ .shortopt = L'e', .longopt = "enum", .helpstr = "pick one of a predetermined set of arguments",
+	  .type = ENUM_ARG, .takes_arg = REQ_ARG, .sizeof_arg = sizeof *(&e), .argptr = (&e), .enum_args = (enum_args) },
+	{ .shortopt = L'c', .longopt = "callback", .helpstr = "call callback",
+	  DRYARG((dryopt_callback)callback), .takes_arg = OPT_ARG, .assign_val = {0} },
+};
+
+#ifdef DRYOPT_GEN_HELP
+int main(int argc, char *argv[])
+{
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	FILE * out;
+
+	ctx.config.utf8 = 1;
+	ctx.prognam = "test-gen", ctx.help_args = "[ARGS]", ctx.help_extra = NULL;
+
+	if (argc < 2 || !(out = fopen(argv[1], "w")))
+		return perror(argc < 2 ? argv[0] : argv[1]), 1;
+	dryopt_help_c(&ctx, opts, sizeof opts / sizeof *opts, "opts", out);
+	if (fclose(out))
+		return perror(argv[1]), 1;
+
+	if (argc > 2) {
+		if (!(out = fopen(argv[2], "w")))
+			return perror(argv[2]), 1;
+		dryopt_man_r(&ctx, opts, sizeof opts / sizeof *opts, "1", out);
+		if (fclose(out))
+			return perror(argv[2]), 1;
+	}
+	return 0;
+}
+#else
+#include "test-gen-help.h"
+
+static uint32_t const opts_phash_seeds[] = {
+	1, 25, 17, 3
+};
+
+static struct dryopt_phash_slot const opts_phash_slots[] = {
+	{ "bigvalue", 8, 1, 0 },
+	{ "enum", 4, 5, 0 },
+	{ "noflag", 6, 3, 1 },
+	{ "value", 5, 0, 0 },
+	{ "float", 5, 4, 0 },
+	{ "no-flag", 7, 3, 1 },
+	{ "callback", 8, 6, 0 },
+	{ "flag", 4, 3, 0 },
+	{ "strarg", 6, 2, 0 },
+};
+
+struct dryopt_phash const opts_phash = {
+	opts_phash_seeds, opts_phash_slots, 4, 9, 0, opts_help_text
+};
+
+#define opts_PARSE(ARGV) dryopt_parse_phash((ARGV), opts,	\
+		sizeof opts / sizeof *opts, &opts_phash)
+
+static bool again = false;
+
+int main(int argc __attribute__((unused)), char *const argv[]) {
+	if (getenv("TEST_COMPLAIN"))
+		dryopt_config.autodie = complain;
+	size_t i = opts_PARSE(argv);
+	// TEST_AGAIN: parse the operands with another table, whose help isn't ours
+	if (getenv("TEST_AGAIN") && i) {
+		struct dryopt again_opts[] = {
+			DRYOPT(L'x', "again", "set again", NO_ARG, &again, 1)
+		};
+		i += DRYOPT_PARSE(argv + i - 1, again_opts) - 1;
+	}
+	printf("-v %"PRId16"	-b %"PRIuMAX"	-s %s	-n %d	-F %g\n"
+		"arguments after options:",
+		value, bigvalue, strarg, flag, fl);
+	while (argv[i])
+		printf("\t%s", argv[i++]);
+	putchar('\n');
+	return 0;
+}
+#endif /* DRYOPT_GEN_HELP */
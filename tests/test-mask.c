@@ -4,16 +4,38 @@
 enum { foo = 1, bar = 2, mung = 4, snark = 8 };
 static unsigned char mask = 0;
 
-#define OPT(n)	\
-	{ .longopt = #n, .assign_val.u = n, .type = UNSIGNED,	\
+#define OPT_AS(name, n)	\
+	{ .longopt = name, .assign_val.u = n, .type = UNSIGNED,	\
 	  .takes_arg = NO_ARG, .set_arg = DRYARG_OR,		\
 	  .sizeof_arg = sizeof mask, .argptr = &mask }
+#define OPT(n)	OPT_AS(#n, n)
 
 struct dryopt opts[] = { OPT(foo), OPT(bar), OPT(mung), OPT(snark) };
+#ifdef SORTING
+/* out of order as well, and parsed after opts[], sorting it too: opts[]
+   being sorted says nothing about this one */
+struct dryopt more[] = { OPT_AS("b", foo), OPT_AS("abc", bar), OPT_AS("ab", mung) };
+#endif
 
 int main(int argc __attribute__((unused)), char *const argv[])
 {
+#ifdef SORTING
+	dryopt_config.sorting = SORTING;
+#endif
+#ifdef COMPILED
+	static char buf[4096];
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	if (dryopt_compile(&ctx, opts, sizeof opts / sizeof *opts, buf, sizeof buf) - 1 >= sizeof buf)
+		return 2;
+	dryopt_parse_compiled(&ctx, argv, buf);
+#elif defined SORTING
+	size_t const i = DRYOPT_PARSE(argv, opts);
+	// anything after `--', with more[]
+	if (argv[i])
+		DRYOPT_PARSE(argv + i - 1, more);
+#else
 	DRYOPT_PARSE(argv, opts);
+#endif
 	printf("%d\n", mask);
 	return 0;
 }
@@ -49,6 +49,12 @@ test_range() {
 	done
 }
 
+case $exe in
+*-sorted)
+	# do_sort is for each table parsed, not just the first
+	do_test 7 --bar -- --ab --b
+esac
+
 nproc=`nproc`
 # 16 is the number of tests to do, testing 0..15. I don't think starting
 # more than 4 jobs will be worth it
@@ -0,0 +1,40 @@
+// A multi-call binary: `add' and `del', by argv[0] or first operand
+
+#include "../dryopt.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+static bool quiet = false, force = false;
+static int num = 1;
+
+static struct dryopt global[] = {
+	DRYOPT(L'q', "quiet", "say less", NO_ARG, &quiet, 1)
+};
+static struct dryopt add_opts[] = {
+	DRYOPT(L'n', "num", "how many to add", REQ_ARG, &num, 0)
+};
+static struct dryopt del_opts[] = {
+	DRYOPT(L'f', "force", "delete anyway", NO_ARG, &force, 1),
+	// shadows the global one
+	DRYOPT(L'q', "quick", "don't bother asking", NO_ARG, &force, 1)
+};
+// sorted by name
+static struct dryopt_cmd const cmds[] = {
+	{ "add", add_opts, sizeof add_opts / sizeof *add_opts },
+	{ "del", del_opts, sizeof del_opts / sizeof *del_opts }
+};
+
+int main(int argc __attribute__((unused)), char *const argv[]) {
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	size_t i;
+	size_t const cmd = DRYOPT_DISPATCH(&ctx, argv, global, cmds, &i);
+
+	if (cmd == sizeof cmds / sizeof *cmds)
+		return 1;
+	printf("%s: quiet %d, num %d, force %d, operands:", cmds[cmd].name, quiet, num, force);
+	while (argv[i])
+		printf(" %s", argv[i++]);
+	putchar('\n');
+	return 0;
+}
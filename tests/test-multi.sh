@@ -0,0 +1,21 @@
+#!/bin/sh
+# tests/test-multi: dispatch by first operand, and by argv[0] through a
+# symlink
+set -efu
+exe=./$1
+
+. "${0%/*}/common.sh"
+
+do_test 'add: quiet 1, num 3, force 0, operands: x y' $exe -q add -n3 x y
+do_test 'add: quiet 1, num 1, force 0, operands: x' $exe add --quiet x
+do_test 'del: quiet 0, num 1, force 1, operands:' $exe del -q
+do_test 'del: quiet 1, num 1, force 1, operands: -q' $exe del --quie --fo -- -q
+do_test "$exe: unknown command: mung" $exe -q mung
+do_test "$exe: no command given" $exe -q
+do_test "$exe: unrecognised option: f" $exe add -f
+
+dir=${TMPDIR:-/tmp}/dryopt-multi.$$
+trap 'rm -rf "$dir"' EXIT
+mkdir "$dir"
+ln -s "$PWD/$exe" "$dir/add"
+do_test 'add: quiet 1, num 2, force 0, operands: del' "$dir/add" -qn2 del
@@ -0,0 +1,53 @@
+// Typed operands: from argv, or a million made up, on some threads
+
+#include "../dryopt.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MADE_UP_MAX 1000000
+static uint32_t ids[MADE_UP_MAX];
+static double fls[MADE_UP_MAX];
+static char * made_up[MADE_UP_MAX];
+static char made_up_buf[MADE_UP_MAX * sizeof "4294967295"];
+
+static size_t nmade = 0, bad = -1;
+static unsigned nthreads = 0;
+static bool floating = false;
+
+static struct dryopt opts[] = {
+	DRYOPT(L'm', "made-up", "convert this many made-up operands instead", REQ_ARG, &nmade, 0),
+	DRYOPT(L'b', "bad", "spoil this one of them", REQ_ARG, &bad, 0),
+	DRYOPT(L'j', "threads", "on this many threads", REQ_ARG, &nthreads, 0),
+	DRYOPT(L'F', "floating", "into doubles", NO_ARG, &floating, 1)
+};
+
+int main(int argc __attribute__((unused)), char *const argv[]) {
+	struct dryopt_ctx ctx = DRYOPT_CTX_INIT;
+	char *const * operands = argv + DRYOPT_PARSE_R(&ctx, argv, opts);
+	struct dryopt const type = floating ? (struct dryopt){ DRYARG(fls) } : (struct dryopt){ DRYARG(ids) };
+	size_t n, i;
+	uint64_t sum = 0;
+
+	ctx.config.autodie = complain;
+	if (nmade) {
+		char * p = made_up_buf;
+		for (i = 0; i < nmade && i < MADE_UP_MAX; i++)
+			made_up[i] = p, p += sprintf(p, i == bad ? "%zux" : "%zu", i * 4099 % 4294967296u) + 1;
+		operands = made_up, n = i;
+	} else
+		for (n = 0; operands[n] && n < MADE_UP_MAX; n++);
+
+	i = dryopt_parse_operands(&ctx, operands, n, &type, nthreads);
+	if (i != n)
+		printf("first bad: %zu\n", i);
+	for (i = 0; i < n; i++)
+		sum += floating ? (uint64_t)fls[i] : ids[i];
+	if (nmade)
+		printf("%zu operands, sum %"PRIu64"\n", n, sum);
+	else
+		for (i = 0; i < n; i++)
+			floating ? printf("%g\n", fls[i]) : printf("%"PRIu32"\n", ids[i]);
+	return ctx.config.mistakes_were_made;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+# tests/test-operands: typed operands, a few from argv and a million made
+# up, split between threads or not
+set -efu
+exe=./$1
+
+. "${0%/*}/common.sh"
+
+do_test '1
+255
+4294967295' $exe 1 0xff 4294967295
+do_test '0.5
+-2' $exe -F -- .5 -2
+do_test "$exe: operand 2: x: not UNSIGNED
+first bad: 1
+7
+0
+8" $exe 7 x 8
+echo "+> $exe 4294967296"
+case `$exe 4294967296 2>&1` in
+"$exe: operand 1: 4294967296: "*) ;;
+*)
+	echo ">>> $exe 4294967296: bad diagnostic"
+	exit 1
+esac
+
+n=1000000 sum=$(( 4099 * 1000000 * 999999 / 2 ))
+for j in 1 3 8; do
+	do_test "$n operands, sum $sum" $exe -m$n -j$j
+	do_test "$exe: operand 654322: $(( 654321 * 4099 ))x: not UNSIGNED
+first bad: 654321
+$n operands, sum $(( sum - 654321 * 4099 ))" $exe -m$n -j$j -b654321
+done
+do_test "$n operands, sum $sum" $exe -F -m$n
@@ -60,18 +60,38 @@ fail_test() {
 	return 0
 }
 
+# the non-ASCII options, where they're taken as UTF-8
+case $exename in
+*-u*)
+	utf8_help='
+  -é                             set flag, but with an é
+  -λ SIGNED                      set value, but λ'
+	;;
+*)
+	utf8_help=
+esac
+
+# generated help is rendered at build time, under the spec's name
+case $exename in
+test-gen*)
+	usage_prog=$exename
+	;;
+*)
+	usage_prog="*[[:punct:]]$exename*"
+esac
+
 test_help() {
 	set_reality_or_die "$@"
 	case $reality in
 	"\
-Usage: "*[[:punct:]]$exename*' [OPTS] [ARGS]
+Usage: "$usage_prog' [OPTS] [ARGS]
   -v, --value=SIGNED             set value
   -b, --bigvalue=[UNSIGNED]      set bigvalue
   -s, --strarg=[STR]             set strarg
   -n, --[no-]flag                boolean; takes no argument
   -F, --float=FLOATING           set fl (double)
   -e, --enum=never,auto,always   pick one of a predetermined set of arguments
-  -c, --callback=[ARG]           call callback
+  -c, --callback=[ARG]           call callback'"$utf8_help"'
   -h, -?, --help                 Print this help and exit')
 		;;
 	*)
@@ -104,6 +124,56 @@ fi
 for i in 32768 -32769; do
 	fail_test "$i: $erange_str" --value:$i
 done
+fail_test "-1: $erange_str" --bigvalue=-1
+fail_test "1e309: $erange_str" --float=1e309
+
+# and carrying on past them, with nothing stored, and the rest of a bundle
+# not taken for options
+set -- -v5 --value=70000 -v99999n -F2 --float=1e309 -b 99999999999999999999 x
+export TEST_COMPLAIN=1
+do_test '-v 5	-b 1	-s (null)	-n 0	-F 2
+arguments after options:	x' "$@" 2>/dev/null
+echo "+> $exe $* >/dev/null"
+reality=`$exe "$@" 2>&1 >/dev/null`
+expectation="$exe: 70000: $erange_str
+$exe: 99999: $erange_str
+$exe: 1e309: $erange_str
+$exe: 99999999999999999999: $erange_str"
+if test "$expectation" != "$reality"; then
+	printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+		"$exe $*" "$expectation" "$reality"
+	exit 1
+fi
+unset TEST_COMPLAIN
+set --
+
+# numbers in all their forms
+do_test '-v -32768	-b 255	-s (null)	-n 0	-F 2500
+arguments after options:'	\
+	--value=-0x8000 --bigvalue=0377 --float=.25e4
+do_test '-v 0	-b 1	-s (null)	-n 0	-F 0.1
+arguments after options:'	\
+	--float=0.1000000000000000000000000001
+
+# enum arguments can be abbreviated, as long as it's unambiguous
+for i in -ene --enum=al --enum=auto; do
+	do_test '-v 0	-b 1	-s (null)	-n 0	-F 0
+arguments after options:'	\
+		$i
+done
+fail_test "ambiguous argument \`a' could be: auto, always" --enum=a
+
+# likewise long options, getopt_long(3)-style
+do_test '-v 5	-b 1	-s (null)	-n 0	-F 0
+arguments after options:	x'	\
+	--val 5 --fla --no-fla x
+do_test '-v 0	-b 1	-s (null)	-n 0	-F 2
+arguments after options:'	\
+	--flag --no-f --flo=2
+fail_test 'option --fl is ambiguous; possibilities: --flag, --float' --fl
+# --flag being the only negatable option doesn't make --n or --no mean --no-flag
+fail_test 'unrecognised long option: n' --n
+fail_test 'unrecognised long option: no' --no
 
 test_help -h
 test_help '-?'
@@ -160,3 +230,247 @@ arguments after options:	-'	\
 do_test '-v 0	-b 0	-s (null)	-n 0	-F 0
 arguments after options:	-'	\
 	-b -
+
+# Long arguments, with more separators in them, at every alignment
+long=0123456789abcdef=0123456789abcdef:0123456789abcdef
+for i in '' x xx xxx xxxxxxxxxxxxxxx; do
+	do_test "-v 0	-b 1	-s $i$long	-n 0	-F 0
+arguments after options:"	\
+		--strarg=$i$long
+done
+do_test "-v 0	-b 1	-s x=y	-n 0	-F 0
+arguments after options:"	\
+		--strarg:x=y
+
+# Shell completion, from the table: long options by prefix, --no- forms,
+# enum values after the option, after `=' and after bash's split `=',
+# and files or nothing for the rest
+do_test '--value' --dryopt-complete 1 "$exe" --v
+do_test '--no-flag' --dryopt-complete 1 "$exe" --no
+do_test '--value
+--bigvalue
+--strarg
+--flag
+--float
+--enum
+--callback
+--help' --dryopt-complete 1 "$exe" --
+do_test 'auto
+always' --dryopt-complete 2 "$exe" --enum a
+do_test '--enum=always' --dryopt-complete 1 "$exe" --enum=al
+do_test 'never
+auto
+always' --dryopt-complete 2 "$exe" --enum =
+do_test 'never' --dryopt-complete 3 "$exe" --en = n
+do_test 'never
+auto
+always' --dryopt-complete 2 "$exe" -ne ''
+do_test '' --dryopt-complete 2 "$exe" -F ''
+do_test ':file' --dryopt-complete 2 "$exe" -s x
+do_test ':file' --dryopt-complete 3 "$exe" -- --v
+do_test ':file--strarg=' --dryopt-complete 1 "$exe" --strarg=
+if command -v bash >/dev/null; then
+	echo "+> $exe --dryopt-complete-script bash | bash -n"
+	$exe --dryopt-complete-script bash | bash -n
+fi
+
+# Options after operands, where permuting
+case $exename in
+*-p*)
+	export TEST_PERMUTED=1
+	do_test 'permuted:	-n	--value	5	-b	--	x	y	-	z	-n	w
+-v 5	-b 0	-s (null)	-n 1	-F 0
+arguments after options:	x	y	-	z	-n	w'	\
+		x -n y --value 5 - -b z -- -n w
+	do_test 'permuted:	-scb	x	y
+-v 0	-b 1	-s cb	-n 0	-F 0
+arguments after options:	x	y'	\
+		x -scb y
+	# options keep their order, so their arguments stay with them
+	do_test 'permuted:	-v	5	-n	-F	2	-b	7	a	b	c	d
+-v 5	-b 7	-s (null)	-n 1	-F 2
+arguments after options:	a	b	c	d'	\
+		a -v 5 b -n -F 2 c d -b 7
+	fail_test 'missing SIGNED argument to -v' x -v
+	unset TEST_PERMUTED
+esac
+
+# Non-ASCII options in UTF-8, with no help from the locale, which is left
+# alone
+case $exename in
+*-u*)
+	do_test '-v 42	-b 1	-s (null)	-n 1	-F 0
+arguments after options:	é'	\
+		-éλ42 é
+	do_test '-v -7	-b 1	-s (null)	-n 1	-F 0
+arguments after options:'	\
+		-λ -7 -é
+	fail_test 'unrecognised option: ñ' -nñ
+	ff=`printf '\377'`	# never in UTF-8
+	echo "+> $exe -n(0xff)"
+	if reality=`$exe -n"$ff" 2>&1 >/dev/null`; then
+		echo "$exe -n(0xff): false success"
+		exit 1
+	fi
+	case $reality in
+	*": byte 2 of \`-n"*) ;;
+	*)
+		printf '>>> %s:\n>>> bad EILSEQ:\n%s\n' "$exe" "$reality"
+		exit 1
+	esac
+	export TEST_LOCALE=1 LC_ALL=C.UTF-8
+	do_test 'locale: C
+-v 0	-b 1	-s (null)	-n 0	-F 0
+arguments after options:'
+	unset TEST_LOCALE
+	LC_ALL=C
+	# wrapped by columns: é's line is exactly as wide as there's room for,
+	# so only fits if it's not counted in bytes
+	echo "+> TEST_WRAP=56 $exe --help"
+	reality=`TEST_WRAP=56 $exe --help`
+	expectation="Usage: $exe [OPTS] [ARGS]
+  -v, --value=SIGNED             set value
+  -b, --bigvalue=[UNSIGNED]      set bigvalue
+  -s, --strarg=[STR]             set strarg
+  -n, --[no-]flag                boolean; takes no
+                                 argument
+  -F, --float=FLOATING           set fl (double)
+  -e, --enum=never,auto,always   pick one of a
+                                 predetermined set of
+                                 arguments
+  -c, --callback=[ARG]           call callback
+  -é                             set flag, but with an é
+  -λ SIGNED                      set value, but λ
+  -h, -?, --help                 Print this help and
+                                 exit"
+	if test "$expectation" != "$reality"; then
+		printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+			"TEST_WRAP=56 $exe --help" "$expectation" "$reality"
+		exit 1
+	fi
+esac
+
+# Instrumentation, where it's switched on
+case $exename in
+*-r*)
+	echo "+> TEST_TRACE=1 $exe -nv5 --no-fla --float 2 -b x"
+	reality=`TEST_TRACE=1 $exe -nv5 --no-fla --float 2 -b x 2>&1 >/dev/null`
+	expectation='short flag (none)
+short value 5
+negated flag (none)
+long float 2
+short bigvalue (none)
+args 5, short 3, long 1, negated 1, conversions 3'
+	if test "$expectation" != "$reality"; then
+		printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+			"TEST_TRACE=1 $exe" "$expectation" "$reality"
+		exit 1
+	fi
+esac
+
+# Config files, reloaded, where supported
+case $exename in
+*-r*)
+	conf=${TMPDIR:-/tmp}/dryopt-conf.$$
+	trap 'rm -f "$conf.1" "$conf.2"' EXIT
+	printf '%s\n' '# comment' 'value=5' '' '  flag  ' 'float=2' 'strarg=a' 'callback=cb' >"$conf.1"
+	printf '%s\n' 'value=5' 'no-flag' 'float=3' 'strarg=a' 'callback=cb' 'enum=nev' >"$conf.2"
+	echo "+> TEST_CONFIG='$conf.1 $conf.2' $exe -b7 x"
+	reality=`TEST_CONFIG="$conf.1 $conf.2" $exe -b7 x 2>&1 >/dev/null`
+	reality="$reality
+"`TEST_CONFIG="$conf.1 $conf.2" $exe -b7 x 2>/dev/null`
+	expectation="$conf.1: 5 applied
+$conf.2: 4 applied
+callback saw: cb
+-v 5	-b 7	-s a	-n 0	-F 3
+arguments after options:	x"
+	if test "$expectation" != "$reality"; then
+		printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+			"TEST_CONFIG=... $exe" "$expectation" "$reality"
+		exit 1
+	fi
+	printf '%s\n' 'value=5' 'bogus=1' >"$conf.1"
+	echo "+> TEST_CONFIG=$conf.1 $exe"
+	case `TEST_CONFIG=$conf.1 $exe 2>&1 >/dev/null` in
+	"$conf.1:2: unrecognised long option: bogus") ;;
+	*)
+		echo ">>> TEST_CONFIG=$conf.1 $exe: bad diagnostic"
+		exit 1
+	esac
+	# nor is --help there, to print usage and exit(3) from a config file
+	printf '%s\n' 'value=5' 'help' >"$conf.1"
+	echo "+> TEST_CONFIG=$conf.1 $exe"
+	case `TEST_CONFIG=$conf.1 $exe 2>&1` in
+	"$conf.1:2: unrecognised long option: help") ;;
+	*)
+		echo ">>> TEST_CONFIG=$conf.1 $exe: help from a config file"
+		exit 1
+	esac
+	# a STR whose line went mustn't point into the old file
+	printf '%s\n' 'strarg=hello' 'value=3' >"$conf.1"
+	printf '%s\n' 'value=4' >"$conf.2"
+	echo "+> TEST_CONFIG='$conf.1 $conf.2' $exe"
+	reality=`TEST_CONFIG="$conf.1 $conf.2" $exe 2>/dev/null`
+	expectation='-v 4	-b 1	-s (null)	-n 0	-F 0
+arguments after options:'
+	if test "$expectation" != "$reality"; then
+		printf '>>> %s:\n>>> expected:\n%s\n>>> got:\n%s\n' \
+			"TEST_CONFIG=... $exe" "$expectation" "$reality"
+		exit 1
+	fi
+esac
+
+# @file response files, where supported
+case $exename in
+*-a*)
+	rsp=${TMPDIR:-/tmp}/dryopt-rsp.$$
+	trap 'rm -f "$rsp" "$rsp.2"' EXIT
+	printf '%s\n' '-n @'"$rsp.2"' "two words"' "'it''s'" 'back\ slash' '""' >"$rsp"
+	printf '%s\n' '--value 12 foo' >"$rsp.2"
+	do_test '-v 12	-b 0	-s (null)	-n 1	-F 0
+arguments after options:	foo	two words	its	back slash		bar'	\
+		-b @"$rsp" bar
+	do_test '-v 12	-b 1	-s (null)	-n 0	-F 0
+arguments after options:	foo	@nonexistent'	\
+		@"$rsp.2" @nonexistent
+	: >"$rsp.2"
+	do_test '-v 0	-b 0	-s (null)	-n 0	-F 0
+arguments after options:	@'	\
+		-b @"$rsp.2" @
+esac
+
+# NUL-delimited arguments on stdin after argv, through a 48 byte buffer
+case $exename in
+*-s*)
+	printf '%s\0' -v 7 0123456789abcde 0123456789 abcdefghijklmn x |
+	do_test '-v 7	-b 1	-s argv	-n 1	-F 0
+arguments after options:	0123456789abcde	0123456789	abcdefghijklmn	x'	\
+		-n -sargv
+	{ printf '%s\0' -b 010 op; printf unterminated; } |
+	do_test '-v 0	-b 8	-s (null)	-n 0	-F 0
+arguments after options:	op	unterminated'
+	echo "+> $exe < (too long)"
+	if reality=`printf 'much too long to fit three times over into the buffer\0' | $exe`
+	then
+		echo "$exe: false success"
+		exit 1
+	fi
+	case $reality in
+	*'
+Argument list too long') ;;
+	*)
+		printf '>>> %s:\n>>> bad E2BIG:\n%s\n' "$exe" "$reality"
+		exit 1
+	esac
+esac
+
+# Generated help goes with its own table, not the next one parsed
+case $exename in
+test-gen*)
+	export TEST_AGAIN=1
+	do_test "Usage: $exe [OPTS] [ARGS]
+  -x, --[no-]again   set again
+  -h, -?, --help     Print this help and exit"	\
+		-n -- --help
+	unset TEST_AGAIN
+esac